@@ -0,0 +1,336 @@
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define HAVE_AVX2 1
+#endif
+
+// batched occupancy, attack maps and checked state of many independent boards
+// boards are transposed into structure-of-arrays layout (pos[slot][lane]) so that
+// one AVX2 instruction handles the same piece slot of BATCH_WIDTH boards at once
+// rook and bishop lines are filled step by step on the monoboard instead of makeStep's recursion
+// the scalar path runs the same bit operations lane by lane, for machines without AVX2
+// (SSE has no per-lane variable shift, so there is no SSE path)
+
+#define BATCH_WIDTH 8
+#define BATCH_SLOTS 12
+#define FULL_MAP 0x1FFFFFF
+#define LEFT_COLUMN 0x108421
+#define RIGHT_COLUMN 0x1084210
+
+// slot k of a batch holds the piece at offset (k < 6 ? k : k + 2) of a Board
+// occupied[player]: pos of player's pieces, attacked[player]: pos reachable by player's pieces
+// (including pos held by player), checked[player]: 1 when player's king is attacked else 0
+typedef struct boardbatch
+{
+    int count;
+    unsigned int pos[BATCH_SLOTS][BATCH_WIDTH];
+    MonoBoard occupied[2][BATCH_WIDTH], attacked[2][BATCH_WIDTH];
+    int checked[2][BATCH_WIDTH];
+} BoardBatch;
+
+// offsets of a step on the monoboard and the pos which can not be reached by wrapping around
+// ↑, ↓, ←, →, ↗︎, ↖︎, ↘︎, ↙︎ (same order as directions)
+int stepshift[8] = {5, -5, -1, 1, 6, 4, -4, -6};
+MonoBoard stepmask[8] = {
+    FULL_MAP, FULL_MAP, FULL_MAP & ~RIGHT_COLUMN, FULL_MAP & ~LEFT_COLUMN,
+    FULL_MAP & ~LEFT_COLUMN, FULL_MAP & ~RIGHT_COLUMN, FULL_MAP & ~LEFT_COLUMN, FULL_MAP & ~RIGHT_COLUMN
+};
+
+void loadBatch(BoardBatch* bb, const Board* boards, int count);
+MonoBoard slideMap(MonoBoard from, MonoBoard empty, int first);
+MonoBoard getAttackMap(Pos pos, Piece piece, MonoBoard empty);
+void analyseBatchScalar(BoardBatch* bb);
+void analyseBatchAVX2(BoardBatch* bb);
+void analyseBatch(BoardBatch* bb);
+void benchBatch(int count);
+
+// transpose up to BATCH_WIDTH boards into bb, missing lanes are filled with the first board
+void loadBatch(BoardBatch* bb, const Board* boards, int count)
+{
+    const Pos* p;
+
+    bb->count = count;
+    for (int lane = 0; lane < BATCH_WIDTH; lane++)
+    {
+        p = (const Pos*)&boards[lane < count ? lane : 0];
+        for (int k = 0; k < BATCH_SLOTS; k++) bb->pos[k][lane] = p[k < 6 ? k : k + 2];
+    }
+}
+
+// pos reached from the marked pos of a rook (first = 0) or a bishop (first = 4) until it hits any piece
+MonoBoard slideMap(MonoBoard from, MonoBoard empty, int first)
+{
+    MonoBoard map = 0x0, cur;
+
+    for (int d = first; d < first + 4; d++)
+    {
+        cur = from;
+        for (int i = 0; i < 4 && cur; i++)
+        {
+            cur = (stepshift[d] > 0 ? cur << stepshift[d] : cur >> -stepshift[d]) & stepmask[d];
+            map |= cur;
+            cur &= empty;
+        }
+    }
+
+    return map;
+}
+
+// pos reachable by the piece at pos (on-board supposed), including pos held by any piece
+// empty: monoboard with free pos marked
+MonoBoard getAttackMap(Pos pos, Piece piece, MonoBoard empty)
+{
+    int promoted = isPromoted(pos), col = convert2digit(pos & 0xF);
+    int idx = (convert2digit(pos >> 4) - 1) * 5 + col - 1, shift = idx - 12;
+    MonoBoard map = 0x0, mask;
+
+    if (piece == ROOK || piece == BISHOP)
+    {
+        map = slideMap(1 << idx, empty, piece == ROOK ? 0 : 4);
+        if (!promoted) return map;
+        // promoted rook and bishop move like king in addition
+        piece = KING;
+    }
+    // promoted pawn and silver move like gold
+    if (promoted && piece < GOLD) piece = GOLD;
+    // same as getMoveMask
+    mask = piecemask[piece + getPlayer(pos) * 8];
+    return map | ((shift < 0 ? mask >> -shift : mask << shift) & helpermask[col - 1]);
+}
+
+void analyseBatchScalar(BoardBatch* bb)
+{
+    MonoBoard king[2], empty;
+    unsigned int pos;
+    int idx;
+
+    for (int lane = 0; lane < BATCH_WIDTH; lane++)
+    {
+        bb->occupied[0][lane] = bb->occupied[1][lane] = 0x0;
+        bb->attacked[0][lane] = bb->attacked[1][lane] = 0x0;
+        king[0] = king[1] = 0x0;
+
+        for (int k = 0; k < BATCH_SLOTS; k++)
+        {
+            pos = bb->pos[k][lane];
+            if (pos == 0x00 || pos == 0xFF) continue;
+            idx = pos2idx(pos);
+            bb->occupied[getPlayer(pos)][lane] |= 1 << idx;
+            if (k % 6 == KING) king[getPlayer(pos)] |= 1 << idx;
+        }
+        empty = FULL_MAP & ~(bb->occupied[0][lane] | bb->occupied[1][lane]);
+
+        for (int k = 0; k < BATCH_SLOTS; k++)
+        {
+            pos = bb->pos[k][lane];
+            if (pos == 0x00 || pos == 0xFF) continue;
+            bb->attacked[getPlayer(pos)][lane] |= getAttackMap(pos, k % 6, empty);
+        }
+
+        bb->checked[0][lane] = !!(bb->attacked[1][lane] & king[0]);
+        bb->checked[1][lane] = !!(bb->attacked[0][lane] & king[1]);
+    }
+}
+
+#ifdef HAVE_AVX2
+// shift every lane of v to the left by shift (to the right when it is negative)
+__attribute__((target("avx2"))) static inline __m256i shiftLanes(__m256i v, __m256i shift)
+{
+    __m256i zero = _mm256_setzero_si256();
+    __m256i left = _mm256_sllv_epi32(v, _mm256_max_epi32(shift, zero));
+    __m256i right = _mm256_srlv_epi32(v, _mm256_max_epi32(_mm256_sub_epi32(zero, shift), zero));
+    return _mm256_blendv_epi8(left, right, _mm256_cmpgt_epi32(zero, shift));
+}
+
+// x -> x (x < 7), x - 9 (x ≥ 7) in every lane, same as convert2digit
+__attribute__((target("avx2"))) static inline __m256i convertLanes(__m256i x)
+{
+    return _mm256_sub_epi32(x, _mm256_and_si256(_mm256_cmpgt_epi32(x, _mm256_set1_epi32(6)), _mm256_set1_epi32(9)));
+}
+
+__attribute__((target("avx2"))) void analyseBatchAVX2(BoardBatch* bb)
+{
+    __m256i pos, hi, lo, row, col, idx, bit, onboard, player, promoted, base, mask, cur;
+    __m256i occupied[2], attacked[2], kingbit[2], gold[2], king[2], empty;
+    __m256i bits[BATCH_SLOTS], idxs[BATCH_SLOTS], cols[BATCH_SLOTS], players[BATCH_SLOTS], promotes[BATCH_SLOTS];
+    __m256i zero = _mm256_setzero_si256(), one = _mm256_set1_epi32(1), seven = _mm256_set1_epi32(7);
+    __m256i helper = _mm256_setr_epi32(helpermask[0], helpermask[1], helpermask[2], helpermask[3], helpermask[4], 0, 0, 0);
+
+    occupied[0] = occupied[1] = attacked[0] = attacked[1] = kingbit[0] = kingbit[1] = zero;
+    for (int p = 0; p < 2; p++)
+    {
+        gold[p] = _mm256_set1_epi32(piecemask[GOLD + p * 8]);
+        king[p] = _mm256_set1_epi32(piecemask[KING + p * 8]);
+    }
+
+    // occupancy
+    for (int k = 0; k < BATCH_SLOTS; k++)
+    {
+        pos = _mm256_loadu_si256((const __m256i*)bb->pos[k]);
+        onboard = _mm256_xor_si256(_mm256_or_si256(_mm256_cmpeq_epi32(pos, zero),
+            _mm256_cmpeq_epi32(pos, _mm256_set1_epi32(0xFF))), _mm256_set1_epi32(-1));
+        hi = _mm256_srli_epi32(pos, 4);
+        lo = _mm256_and_si256(pos, _mm256_set1_epi32(0xF));
+        row = convertLanes(hi);
+        col = convertLanes(lo);
+        // (row - 1) * 5 + col - 1
+        idx = _mm256_add_epi32(_mm256_add_epi32(_mm256_slli_epi32(row, 2), row), _mm256_sub_epi32(col, _mm256_set1_epi32(6)));
+        bit = _mm256_and_si256(_mm256_sllv_epi32(one, _mm256_and_si256(idx, _mm256_set1_epi32(31))), onboard);
+        player = _mm256_cmpgt_epi32(pos, _mm256_set1_epi32(0x77));
+        promoted = _mm256_xor_si256(_mm256_cmpgt_epi32(seven, hi), _mm256_cmpgt_epi32(seven, lo));
+
+        occupied[0] = _mm256_or_si256(occupied[0], _mm256_andnot_si256(player, bit));
+        occupied[1] = _mm256_or_si256(occupied[1], _mm256_and_si256(player, bit));
+        if (k % 6 == KING)
+        {
+            kingbit[0] = _mm256_or_si256(kingbit[0], _mm256_andnot_si256(player, bit));
+            kingbit[1] = _mm256_or_si256(kingbit[1], _mm256_and_si256(player, bit));
+        }
+        bits[k] = bit;
+        idxs[k] = idx;
+        cols[k] = col;
+        players[k] = player;
+        promotes[k] = promoted;
+    }
+    empty = _mm256_andnot_si256(_mm256_or_si256(occupied[0], occupied[1]), _mm256_set1_epi32(FULL_MAP));
+
+    // attack maps
+    for (int k = 0; k < BATCH_SLOTS; k++)
+    {
+        int piece = k % 6;
+        bit = bits[k];
+        player = players[k];
+        promoted = promotes[k];
+        mask = zero;
+
+        if (piece == ROOK || piece == BISHOP)
+        {
+            for (int d = (piece == ROOK ? 0 : 4); d < (piece == ROOK ? 4 : 8); d++)
+            {
+                cur = bit;
+                for (int i = 0; i < 4; i++)
+                {
+                    cur = (stepshift[d] > 0) ? _mm256_slli_epi32(cur, stepshift[d]) : _mm256_srli_epi32(cur, -stepshift[d]);
+                    cur = _mm256_and_si256(cur, _mm256_set1_epi32(stepmask[d]));
+                    mask = _mm256_or_si256(mask, cur);
+                    cur = _mm256_and_si256(cur, empty);
+                }
+            }
+            // promoted rook and bishop move like king in addition
+            base = _mm256_and_si256(_mm256_blendv_epi8(king[0], king[1], player), promoted);
+        }
+        else
+        {
+            base = _mm256_blendv_epi8(_mm256_set1_epi32(piecemask[piece]), _mm256_set1_epi32(piecemask[piece + 8]), player);
+            // promoted pawn and silver move like gold
+            if (piece < GOLD) base = _mm256_blendv_epi8(base, _mm256_blendv_epi8(gold[0], gold[1], player), promoted);
+        }
+        // same as getMoveMask: shift by idx - 12 and remove dislocations
+        base = shiftLanes(base, _mm256_sub_epi32(idxs[k], _mm256_set1_epi32(12)));
+        base = _mm256_and_si256(base, _mm256_permutevar8x32_epi32(helper, _mm256_sub_epi32(cols[k], one)));
+        // off-board pieces attack nothing
+        mask = _mm256_and_si256(_mm256_or_si256(mask, base), _mm256_cmpgt_epi32(bit, zero));
+
+        attacked[0] = _mm256_or_si256(attacked[0], _mm256_andnot_si256(player, mask));
+        attacked[1] = _mm256_or_si256(attacked[1], _mm256_and_si256(player, mask));
+    }
+
+    for (int p = 0; p < 2; p++)
+    {
+        _mm256_storeu_si256((__m256i*)bb->occupied[p], occupied[p]);
+        _mm256_storeu_si256((__m256i*)bb->attacked[p], attacked[p]);
+        // 1 when the king is attacked by the competitor else 0
+        cur = _mm256_cmpeq_epi32(_mm256_and_si256(attacked[!p], kingbit[p]), zero);
+        _mm256_storeu_si256((__m256i*)bb->checked[p], _mm256_add_epi32(cur, one));
+    }
+}
+#endif
+
+// analyse a loaded batch with AVX2 when the cpu supports it
+void analyseBatch(BoardBatch* bb)
+{
+#ifdef HAVE_AVX2
+    if (__builtin_cpu_supports("avx2"))
+    {
+        analyseBatchAVX2(bb);
+        return;
+    }
+#endif
+    analyseBatchScalar(bb);
+}
+
+// boards/second of the reference functions (monoizeBoard + isChecked) against the scalar and the AVX2 batch
+// boards are collected by random walks from the initial layout
+void benchBatch(int count)
+{
+    Board* boards = (Board*)malloc(sizeof(Board) * count);
+    BoardBatch bb;
+    History hist = {0};
+    Move moves[MAX_MOVES_LEN], move;
+    Key seed = 1, hash = 0;
+    MonoBoard sum = 0;
+    long long start, elapsed;
+    int n, mismatch = 0, checked[2];
+
+    if (!boards) return;
+    initHashTable(&table);
+    for (int i = 0; i < count; i++)
+    {
+        if (!i || hist.turn >= MAX_TURNS_NUM - 2 || !(n = getMoveList(boards[i - 1], hist, moves)))
+        {
+            initBoard(&boards[i]);
+            initHistory(&hist);
+            hash = hashBoard(boards[i], DEFENDER);
+            continue;
+        }
+        move = moves[nextRandom(&seed) % n];
+        boards[i] = boards[i - 1];
+        hash = updateHash(boards[i], hash, move);
+        hist.past[hist.turn++] = hash;
+        setBoard(&boards[i], move);
+    }
+
+    start = getTime();
+    for (int i = 0; i < count; i++)
+    {
+        sum += monoizeBoard(boards[i], 0) + isChecked(boards[i], ATTACKER) + isChecked(boards[i], DEFENDER);
+    }
+    elapsed = getTime() - start;
+    printf("reference: %d boards in %lld ms (%lld boards/s)\n", count, elapsed, count * 1000LL / (elapsed + 1));
+
+    for (int avx = 0; avx < 2; avx++)
+    {
+#ifdef HAVE_AVX2
+        if (avx && !__builtin_cpu_supports("avx2")) break;
+#else
+        if (avx) break;
+#endif
+        start = getTime();
+        for (int i = 0; i < count; i += BATCH_WIDTH)
+        {
+            loadBatch(&bb, boards + i, (count - i < BATCH_WIDTH) ? count - i : BATCH_WIDTH);
+            avx ? analyseBatch(&bb) : analyseBatchScalar(&bb);
+            for (int lane = 0; lane < bb.count; lane++) sum += bb.occupied[0][lane] + bb.checked[0][lane];
+        }
+        elapsed = getTime() - start;
+        printf("%s: %d boards in %lld ms (%lld boards/s)\n", avx ? "avx2 batch" : "scalar batch",
+            count, elapsed, count * 1000LL / (elapsed + 1));
+
+        // both paths must agree with the reference
+        for (int i = 0; i < count; i += BATCH_WIDTH)
+        {
+            loadBatch(&bb, boards + i, (count - i < BATCH_WIDTH) ? count - i : BATCH_WIDTH);
+            avx ? analyseBatch(&bb) : analyseBatchScalar(&bb);
+            for (int lane = 0; lane < bb.count; lane++)
+            {
+                checked[0] = isChecked(boards[i + lane], ATTACKER);
+                checked[1] = isChecked(boards[i + lane], DEFENDER);
+                // monoizeBoard marks off-board pieces at bit 25
+                if ((bb.occupied[0][lane] | bb.occupied[1][lane]) != (monoizeBoard(boards[i + lane], 0) & FULL_MAP) ||
+                    bb.checked[0][lane] != checked[0] || bb.checked[1][lane] != checked[1]) mismatch++;
+            }
+        }
+    }
+
+    printf("mismatches: %d (checksum %X)\n", mismatch, sum);
+    free(boards);
+}
@@ -0,0 +1,184 @@
+// search benchmark over a file of positions with known best moves (bench.txt)
+// every position is searched by alpha-beta alone from an empty transposition table
+// under a budget of nodes (the results are reproducible) or of time
+// per position: the depth reached and the nodes from which the best move has stayed a solution
+// in total: solve rate (by category), time to each depth, nodes/s
+// and a signature of the nodes and moves of every iteration, which only changes when the search does
+
+#define BENCH_POSITIONS 128
+#define BENCH_BEST 4
+#define BENCH_CATEGORIES 8
+
+// a line of the file: <id> <category> <best>[,<best> ...] startpos [moves m1 m2 ...]
+typedef struct benchposition
+{
+    char id[32], category[32];
+    Board board;
+    History hist;
+    Move best[BENCH_BEST];
+    int bestlen;
+} BenchPosition;
+
+int loadBench(const char* path, BenchPosition* positions);
+int isSolution(BenchPosition* bp, Move move);
+int bench(const char* path, long long maxnodes, long long timelimit);
+
+// return the number of positions or -1 when the file is broken
+int loadBench(const char* path, BenchPosition* positions)
+{
+    FILE* fp = fopen(path, "r");
+    char line[MAX_LINE_LEN], id[32], category[32], best[64], *token;
+    BenchPosition* bp;
+    Move moves[MAX_MOVES_LEN];
+    Key hash;
+    int count = 0, number = 0, broken, legal, i, len;
+
+    if (!fp)
+    {
+        fprintf(stderr, "%s: cannot open\n", path);
+        return -1;
+    }
+
+    while (fgets(line, MAX_LINE_LEN, fp))
+    {
+        number++;
+        if (line[0] == '#' || sscanf(line, "%31s%31s%63s%n", id, category, best, &len) != 3) continue;
+        if (count == BENCH_POSITIONS)
+        {
+            fprintf(stderr, "%s:%d: more than %d positions\n", path, number, BENCH_POSITIONS);
+            break;
+        }
+        bp = &positions[count];
+        strcpy(bp->id, id);
+        strcpy(bp->category, category);
+
+        initBoard(&bp->board);
+        initHistory(&bp->hist);
+        hash = hashBoard(bp->board, DEFENDER);
+        token = strtok(line + len, " \t\n");
+        if (!token || strcmp(token, "startpos"))
+        {
+            fprintf(stderr, "%s:%d: only startpos is supported\n", path, number);
+            break;
+        }
+        token = strtok(NULL, " \t\n");
+        if (token && strcmp(token, "moves"))
+        {
+            fprintf(stderr, "%s:%d: moves expected\n", path, number);
+            break;
+        }
+        while ((token = strtok(NULL, " \t\n")) && playMove(&bp->board, &bp->hist, &hash, token));
+        if (token)
+        {
+            fprintf(stderr, "%s:%d: illegal move %s\n", path, number, token);
+            break;
+        }
+
+        // the best moves must be legal in the position
+        legal = getMoveList(bp->board, bp->hist, moves);
+        bp->bestlen = 0;
+        for (token = strtok(best, ","); token && bp->bestlen < BENCH_BEST; token = strtok(NULL, ","))
+        {
+            bp->best[bp->bestlen] = (strlen(token) == 4 || strlen(token) == 5) ? parseMove(bp->board, bp->hist.turn % 2, token) : 0;
+            for (i = 0; i < legal && moves[i] != bp->best[bp->bestlen]; i++);
+            if (i == legal) break;
+            bp->bestlen++;
+        }
+        if (token)
+        {
+            fprintf(stderr, "%s:%d: illegal best move %s\n", path, number, token);
+            break;
+        }
+        count++;
+    }
+
+    // stopped before the end by a broken line
+    broken = !feof(fp);
+    fclose(fp);
+    return broken ? -1 : count;
+}
+
+int isSolution(BenchPosition* bp, Move move)
+{
+    for (int i = 0; i < bp->bestlen; i++) if (bp->best[i] == move) return 1;
+    return 0;
+}
+
+// maxnodes, timelimit: budget per position (0 -> unlimited)
+// return 0 when every position was loaded else 1
+int bench(const char* path, long long maxnodes, long long timelimit)
+{
+    static BenchPosition positions[BENCH_POSITIONS];
+    static SearchInfo si;
+    char str[6], categories[BENCH_CATEGORIES][32];
+    Move move;
+    Key signature = 0;
+    long long totalnodes = 0, totaltime = 0, solvednodes, depthnodes[MAX_PLY] = {0}, depthtime[MAX_PLY] = {0};
+    int count, solved = 0, solvedat, reached[MAX_PLY] = {0}, ncategories = 0, c;
+    int tried[BENCH_CATEGORIES] = {0}, passed[BENCH_CATEGORIES] = {0};
+
+    initHashTable(&table);
+    clearMoveCache();
+    if ((count = loadBench(path, positions)) < 0) return 1;
+    printf("%d positions, %lld nodes, %lld ms per position\n", count, maxnodes, timelimit);
+
+    for (int p = 0; p < count; p++)
+    {
+        clearTable();
+        si.board = positions[p].board;
+        si.hist = positions[p].hist;
+        si.maxdepth = 0;
+        si.multipv = 1;
+        si.maxnodes = maxnodes;
+        si.timelimit = timelimit;
+        si.stop = si.pondering = si.infinite = 0;
+        si.verbose = 0;
+        si.start = getTime();
+        move = think(&si);
+        totalnodes += si.nodes;
+        totaltime += getTime() - si.start;
+
+        // the first iteration from which the best move has been a solution
+        solvedat = 0;
+        for (int d = si.depth; d >= 1 && isSolution(&positions[p], si.iterbest[d]); d--) solvedat = d;
+        solvednodes = solvedat ? si.iternodes[solvedat] : 0;
+        solved += !!solvedat;
+
+        for (c = 0; c < ncategories && strcmp(categories[c], positions[p].category); c++);
+        if (c == ncategories && ncategories < BENCH_CATEGORIES) strcpy(categories[ncategories++], positions[p].category);
+        if (c < ncategories)
+        {
+            tried[c]++;
+            passed[c] += !!solvedat;
+        }
+
+        for (int d = 1; d <= si.depth; d++)
+        {
+            reached[d]++;
+            depthnodes[d] += si.iternodes[d];
+            depthtime[d] += si.itertime[d];
+            signature = (signature ^ si.iternodes[d]) * 0x9E3779B97F4A7C15;
+            signature = (signature ^ si.iterbest[d]) * 0x9E3779B97F4A7C15;
+        }
+
+        printf("%-12s %-11s bestmove %-5s depth %2d nodes %8lld", positions[p].id, positions[p].category,
+            move ? formatMove(move, str) : "none", si.depth, si.nodes);
+        if (solvedat) printf(" solved at depth %d (%lld nodes, %lld ms)\n", solvedat, solvednodes, si.itertime[solvedat]);
+        else printf(" unsolved (%s expected)\n", formatMove(positions[p].best[0], str));
+        fflush(stdout);
+    }
+
+    printf("solved %d / %d", solved, count);
+    for (c = 0; c < ncategories; c++) printf(", %s %d / %d", categories[c], passed[c], tried[c]);
+    printf("\n");
+    // by depth: positions which finished it, their average nodes and time to finish it
+    for (int d = 1; d < MAX_PLY && reached[d]; d++)
+    {
+        printf("depth %2d: %3d positions, %10lld nodes, %6lld ms on average\n", d, reached[d], depthnodes[d] / reached[d], depthtime[d] / reached[d]);
+    }
+    printf("total %lld nodes, %lld ms, %lld nps\n", totalnodes, totaltime, totalnodes * 1000 / (totaltime + 1));
+    printf("signature %016llX\n", signature);
+    printMoveCache();
+
+    return 0;
+}
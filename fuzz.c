@@ -0,0 +1,194 @@
+// differential fuzzing of the optimized paths against the reference functions
+// random walks from the initial layout, at every position
+//     getMoveListFast and getMoveListCached vs getMoveList (as multisets)
+//     updateHash / updateHashFast vs hashBoard
+//     isCheckedFast and analyseBatch vs isChecked
+//     no listed move of the attacker repeats a board for the 4th time (千日手)
+// half of the walks prefer moves returning to earlier boards, so that repetitions actually happen
+// a failing walk is shrunk by dropping pairs of moves while it still fails,
+// then printed as a position command which can be given to main usi or main analyse
+
+#define FUZZ_WALK_LEN 120
+
+// a failing case: the moves from the initial layout and the kind of the failure at the end
+typedef struct fuzzcase
+{
+    Move moves[MAX_TURNS_NUM];
+    int len;
+    char reason[128];
+} FuzzCase;
+
+int compareMove(const void* a, const void* b);
+int checkPosition(Board board, History* hist, Key hash, char* reason);
+int replayCase(FuzzCase* fc);
+void shrinkCase(FuzzCase* fc);
+void printCase(FuzzCase* fc);
+int fuzz(long long positions, Key seed);
+
+int compareMove(const void* a, const void* b) { return (int)*(const Move*)a - (int)*(const Move*)b; }
+
+// compare the reference and the optimized paths at a position
+// return 1 and describe the failure in reason when they disagree else 0
+int checkPosition(Board board, History* hist, Key hash, char* reason)
+{
+    Move ref[MAX_MOVES_LEN], fast[MAX_MOVES_LEN], cached[MAX_MOVES_LEN];
+    BoardBatch bb;
+    Key next;
+    int player = hist->turn % 2, count, checked, seen;
+
+    if (hash != hashBoard(board, !player)) return sprintf(reason, "updateHash differs from hashBoard"), 1;
+    if (hashBoardFast(board, !player) != hash) return sprintf(reason, "hashBoardFast differs from hashBoard"), 1;
+
+    loadBatch(&bb, &board, 1);
+    analyseBatch(&bb);
+    for (int p = ATTACKER; p <= DEFENDER; p++)
+    {
+        checked = isChecked(board, p);
+        if (isCheckedFast(board, p) != checked) return sprintf(reason, "isCheckedFast(%d) differs from isChecked", p), 1;
+        if (bb.checked[p][0] != checked) return sprintf(reason, "analyseBatch checked[%d] differs from isChecked", p), 1;
+    }
+
+    count = getMoveList(board, *hist, ref);
+    if (getMoveListFast(board, *hist, fast) != count) return sprintf(reason, "getMoveListFast returns another number of moves"), 1;
+    // the cached list may come from an earlier visit with another history
+    if (getMoveListCached(board, *hist, cached) != count) return sprintf(reason, "getMoveListCached returns another number of moves"), 1;
+    qsort(ref, count, sizeof(Move), compareMove);
+    qsort(fast, count, sizeof(Move), compareMove);
+    qsort(cached, count, sizeof(Move), compareMove);
+    for (int i = 0; i < count; i++)
+    {
+        if (ref[i] != fast[i]) return sprintf(reason, "getMoveListFast returns other moves"), 1;
+        if (ref[i] != cached[i]) return sprintf(reason, "getMoveListCached returns other moves"), 1;
+    }
+
+    for (int i = 0; i < count; i++)
+    {
+        next = updateHash(board, hash, ref[i]);
+        if (updateHashFast(board, hash, ref[i]) != next) return sprintf(reason, "updateHashFast differs from updateHash"), 1;
+        if (player != ATTACKER) continue;
+        // the attacker must not make the same board for the 4th time
+        seen = 0;
+        for (int t = hist->turn - 2; t >= 0; t -= 2) seen += next == hist->past[t];
+        if (seen >= 3) return sprintf(reason, "the attacker may repeat a board for the 4th time"), 1;
+    }
+
+    return 0;
+}
+
+// replay the moves of fc with the reference rules
+// return 1 when every move is legal and the last position still fails else 0
+int replayCase(FuzzCase* fc)
+{
+    Board board;
+    History hist;
+    Move moves[MAX_MOVES_LEN];
+    Key hash;
+    int count, i;
+
+    initBoard(&board);
+    initHistory(&hist);
+    hash = hashBoard(board, DEFENDER);
+    for (int m = 0; m < fc->len; m++)
+    {
+        count = getMoveList(board, hist, moves);
+        for (i = 0; i < count && moves[i] != fc->moves[m]; i++);
+        if (i == count) return 0;
+        hash = updateHash(board, hash, fc->moves[m]);
+        hist.past[hist.turn++] = hash;
+        setBoard(&board, fc->moves[m]);
+    }
+
+    return checkPosition(board, &hist, hash, fc->reason);
+}
+
+// drop pairs of moves (one move of each player, so that the turn stays) while the case keeps failing
+void shrinkCase(FuzzCase* fc)
+{
+    FuzzCase trial;
+    int shrunk = 1;
+
+    while (shrunk)
+    {
+        shrunk = 0;
+        for (int i = 0; i + 1 < fc->len; i++)
+        {
+            trial.len = 0;
+            for (int m = 0; m < fc->len; m++) if (m != i && m != i + 1) trial.moves[trial.len++] = fc->moves[m];
+            if (!replayCase(&trial)) continue;
+            *fc = trial;
+            shrunk = 1;
+            break;
+        }
+    }
+}
+
+void printCase(FuzzCase* fc)
+{
+    char str[6];
+
+    printf("mismatch: %s\nposition startpos moves", fc->reason);
+    for (int m = 0; m < fc->len; m++) printf(" %s", formatMove(fc->moves[m], str));
+    printf("\n");
+}
+
+// run random walks until positions have been checked or a failure is found
+// return 1 when a failure was found else 0
+int fuzz(long long positions, Key seed)
+{
+    static FuzzCase fc;
+    Board board;
+    History hist;
+    Move moves[MAX_MOVES_LEN], back[MAX_MOVES_LEN];
+    Key hash, key;
+    long long checked = 0, walks = 0, start = getTime();
+    int count, found, repeat;
+
+    initHashTable(&table);
+    printf("seed %llu\n", seed);
+
+    while (checked < positions)
+    {
+        initBoard(&board);
+        initHistory(&hist);
+        hash = hashBoard(board, DEFENDER);
+        fc.len = 0;
+        repeat = nextRandom(&seed) & 1;
+        walks++;
+
+        while (hist.turn < FUZZ_WALK_LEN && checked < positions)
+        {
+            checked++;
+            if (checkPosition(board, &hist, hash, fc.reason))
+            {
+                printf("found after %lld positions in walk %lld (%d moves), shrinking\n", checked, walks, fc.len);
+                shrinkCase(&fc);
+                printCase(&fc);
+                return 1;
+            }
+
+            count = getMoveList(board, hist, moves);
+            if (!count) break;
+            // moves back to a board made before
+            found = 0;
+            for (int i = 0; repeat && i < count; i++)
+            {
+                key = updateHash(board, hash, moves[i]);
+                for (int t = hist.turn - 2; t >= 0; t -= 2) if (key == hist.past[t]) { back[found++] = moves[i]; break; }
+            }
+            fc.moves[fc.len++] = found ? back[nextRandom(&seed) % found] : moves[nextRandom(&seed) % count];
+            hash = updateHash(board, hash, fc.moves[fc.len - 1]);
+            hist.past[hist.turn++] = hash;
+            setBoard(&board, fc.moves[fc.len - 1]);
+        }
+
+        if (walks % 100 == 0)
+        {
+            printf("%lld walks, %lld positions, %lld positions/s\n", walks, checked, checked * 1000 / (getTime() - start + 1));
+            fflush(stdout);
+        }
+    }
+
+    printf("no mismatch in %lld positions (%lld walks)\n", checked, walks);
+    printMoveCache();
+    return 0;
+}
@@ -0,0 +1,143 @@
+// quality of zobrist keys measured over a self-play corpus
+//     bit balance of the key table
+//     collisions of the full keys and of truncated keys (against the birthday bound)
+//     false hits of a transposition table indexed like tt, with several widths of the stored check
+
+#define KEYBENCH_TT_BITS 20
+
+// a position of the corpus, player is the one to move
+typedef struct keyrecord
+{
+    Key key;
+    Board board;
+    int player;
+} KeyRecord;
+
+int compareRecord(const void* a, const void* b);
+int compareKey(const void* a, const void* b);
+int isSamePosition(const KeyRecord* a, const KeyRecord* b);
+void benchKeys(int games);
+
+int compareRecord(const void* a, const void* b)
+{
+    const KeyRecord *x = (const KeyRecord*)a, *y = (const KeyRecord*)b;
+    if (x->key != y->key) return (x->key < y->key) ? -1 : 1;
+    if (x->player != y->player) return x->player - y->player;
+    return memcmp(&x->board, &y->board, sizeof(Board));
+}
+
+int compareKey(const void* a, const void* b)
+{
+    Key x = *(const Key*)a, y = *(const Key*)b;
+    return (x > y) - (x < y);
+}
+
+int isSamePosition(const KeyRecord* a, const KeyRecord* b)
+{
+    return a->player == b->player && !memcmp(&a->board, &b->board, sizeof(Board));
+}
+
+// games: number of random self-play games in the corpus
+void benchKeys(int games)
+{
+    KeyRecord* corpus = (KeyRecord*)malloc(sizeof(KeyRecord) * (size_t)games * MAX_TURNS_NUM);
+    KeyRecord* sorted = (KeyRecord*)malloc(sizeof(KeyRecord) * (size_t)games * MAX_TURNS_NUM);
+    Key* truncated = (Key*)malloc(sizeof(Key) * (size_t)games * MAX_TURNS_NUM);
+    int* slots = (int*)malloc(sizeof(int) * (1 << KEYBENCH_TT_BITS));
+    Key *k = (Key*)table.keys, seed = 1, hash;
+    Board board;
+    History hist;
+    Move move, moves[MAX_MOVES_LEN];
+    long long n = 0, distinct = 0, collisions, probes, hits, falsehits;
+    int ones[64] = {0}, count, minones, maxones, constant = 0, widths[4] = {8, 16, 32, 64};
+
+    if (!corpus || !sorted || !truncated || !slots) return;
+    initHashTable(&table);
+
+    // bit balance (bit 0 is the checked mark and always 0 in the table)
+    for (int i = 0; i < KEY_TABLE_ROW * KEY_TABLE_COL; i++)
+    {
+        for (int b = 0; b < 64; b++) ones[b] += (k[i] >> b) & 1;
+    }
+    minones = maxones = ones[1];
+    for (int b = 1; b < 64; b++)
+    {
+        if (ones[b] < minones) minones = ones[b];
+        if (ones[b] > maxones) maxones = ones[b];
+        constant += !ones[b] || ones[b] == KEY_TABLE_ROW * KEY_TABLE_COL;
+    }
+    printf("key table: %d keys, bits 1-63 set in %d-%d keys, %d constant bits\n",
+        KEY_TABLE_ROW * KEY_TABLE_COL, minones, maxones, constant);
+
+    // corpus of random self-play
+    for (int g = 0; g < games; g++)
+    {
+        initBoard(&board);
+        initHistory(&hist);
+        hash = hashBoard(board, DEFENDER);
+        while (hist.turn < MAX_TURNS_NUM - 2)
+        {
+            corpus[n].key = hash;
+            corpus[n].board = board;
+            corpus[n++].player = hist.turn % 2;
+            if (!(count = getMoveListFast(board, hist, moves))) break;
+            move = moves[nextRandom(&seed) % count];
+            hash = updateHash(board, hash, move);
+            hist.past[hist.turn++] = hash;
+            setBoard(&board, move);
+        }
+    }
+
+    // collisions of full keys among distinct positions
+    memcpy(sorted, corpus, sizeof(KeyRecord) * n);
+    qsort(sorted, n, sizeof(KeyRecord), compareRecord);
+    collisions = 0;
+    for (long long i = 0; i < n; i++)
+    {
+        if (i && sorted[i].key == sorted[i - 1].key && isSamePosition(&sorted[i], &sorted[i - 1])) continue;
+        if (distinct && sorted[distinct - 1].key == sorted[i].key) collisions++;
+        sorted[distinct++] = sorted[i];
+    }
+    printf("corpus: %d games, %lld positions, %lld distinct\n", games, n, distinct);
+    printf("64bit keys: %lld collisions\n", collisions);
+
+    // collisions of truncated keys (bit 0 excluded)
+    // n keys into m = 2^bits values are expected to leave n - m * (1 - (1 - 1/m)^n) collisions,
+    // about n^2 / 2m (the birthday bound) while n is much smaller than m
+    for (int bits = 16; bits <= 40; bits += 8)
+    {
+        for (long long i = 0; i < distinct; i++) truncated[i] = (sorted[i].key >> 1) & ((1ULL << bits) - 1);
+        qsort(truncated, distinct, sizeof(Key), compareKey);
+        collisions = 0;
+        for (long long i = 1; i < distinct; i++) collisions += truncated[i] == truncated[i - 1];
+        printf("%dbit keys: %lld collisions (about %.1f expected)\n", bits, collisions,
+            distinct - ldexp(-expm1(distinct * log1p(-ldexp(1.0, -bits))), bits));
+    }
+
+    // transposition table of 2^KEYBENCH_TT_BITS slots, probed and replaced in the order of the games
+    // the slot keeps the upper width bits of the key as its check
+    for (int w = 0; w < 4; w++)
+    {
+        memset(slots, -1, sizeof(int) * (1 << KEYBENCH_TT_BITS));
+        probes = hits = falsehits = 0;
+        for (long long i = 0; i < n; i++)
+        {
+            int* slot = &slots[corpus[i].key & ((1 << KEYBENCH_TT_BITS) - 1)];
+            probes++;
+            if (*slot >= 0 && (widths[w] == 64 ? corpus[*slot].key == corpus[i].key :
+                corpus[*slot].key >> (64 - widths[w]) == corpus[i].key >> (64 - widths[w])))
+            {
+                hits++;
+                falsehits += !isSamePosition(&corpus[*slot], &corpus[i]);
+            }
+            *slot = (int)i;
+        }
+        printf("tt with %dbit check: %lld probes, %lld hits, %lld false hits (%.2e per probe)\n",
+            widths[w], probes, hits, falsehits, (double)falsehits / probes);
+    }
+
+    free(corpus);
+    free(sorted);
+    free(truncated);
+    free(slots);
+}
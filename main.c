@@ -1,4 +1,17 @@
 #include "simulator.c"
+#include "batch.c"
+#include "movegen.c"
+#include "movecache.c"
+#include "search.c"
+#include "mcts.c"
+#include "fuzz.c"
+#include "keybench.c"
+#include "usi.c"
+#include "bench.c"
+
+// build: gcc -O2 -o main main.c -lm -pthread
+
+#define THINKING_TIME 1000
 
 // for debug
 void showBit(MonoBoard monoboard)
@@ -116,9 +129,216 @@ void printBoard(Board board)
     printf("\n");
 }
 
+// search of the computer's last move (its ponder move is the predicted reply of the player)
+SearchInfo cpinfo;
+// background search while the player is thinking
+SearchInfo ponderinfo;
+pthread_t ponderer;
+Engine ponderkind;
+Move predicted;
+
+// computer's move chosen by the given engine within timelimit (ms)
+// return 0 when there is no legal move or the game is out of turns
+Move computeMove(Board board, History hist, Engine kind, long long timelimit)
+{
+    SearchInfo* si = &cpinfo;
+    Move moves[MAX_MOVES_LEN];
+    int count;
+
+    // draw at MAX_TURNS_NUM - 2 turns, as in playMove and searchNode
+    if (hist.turn >= MAX_TURNS_NUM - 2) return 0;
+    if (kind == RANDOM)
+    {
+        count = getMoveListCached(board, hist, moves);
+        return count ? moves[rand() % count] : 0;
+    }
+
+    si->board = board;
+    si->hist = hist;
+    si->maxdepth = 0;
+    si->maxnodes = 0;
+    si->timelimit = timelimit;
+    si->stop = si->pondering = si->infinite = 0;
+    si->verbose = 0;
+    si->start = getTime();
+    return (kind == MONTECARLO) ? mctsThink(si) : think(si);
+}
+
+// entry of the pondering thread
+void* ponderThread(void* arg)
+{
+    SearchInfo* si = (SearchInfo*)arg;
+    (ponderkind == MONTECARLO) ? mctsThink(si) : think(si);
+    return NULL;
+}
+
+// start searching in background on the player's turn
+// alpha-beta searches the position after the predicted move of the player
+// (or the current position to warm the transposition table when nothing is predicted)
+// MCTS searches the current position, its tree covers all replies and gets reused afterwards
+void startPonder(Board board, History hist, Key hash, Engine kind)
+{
+    SearchInfo* si = &ponderinfo;
+    Move moves[MAX_MOVES_LEN];
+    int count = getMoveListCached(board, hist, moves), i;
+
+    // no prediction when the game would be out of turns after it
+    predicted = (kind == ALPHABETA && hist.turn + 1 < MAX_TURNS_NUM - 2) ? cpinfo.ponder : 0;
+    for (i = 0; i < count && moves[i] != predicted; i++);
+    if (i == count) predicted = 0;
+    if (predicted)
+    {
+        hist.past[hist.turn++] = updateHash(board, hash, predicted);
+        setBoard(&board, predicted);
+    }
+
+    si->board = board;
+    si->hist = hist;
+    si->maxdepth = 0;
+    si->maxnodes = 0;
+    si->timelimit = THINKING_TIME;
+    si->stop = si->infinite = 0;
+    si->pondering = 1;
+    si->verbose = 0;
+    si->start = getTime();
+    ponderkind = kind;
+    pthread_create(&ponderer, NULL, ponderThread, si);
+}
+
+// finish the background search once the player's move has come
+// return the computer's reply when the player made the predicted move else 0
+Move stopPonder(Move move)
+{
+    if (predicted && move == predicted)
+    {
+        // the time spent while the player was thinking counts, so the reply is immediate after a long thought
+        ponderinfo.pondering = 0;
+        pthread_join(ponderer, NULL);
+        // the reply is played without computeMove, so the next prediction has to come from this search
+        cpinfo.best = ponderinfo.best;
+        cpinfo.ponder = ponderinfo.ponder;
+        return ponderinfo.best;
+    }
+
+    ponderinfo.stop = 1;
+    pthread_join(ponderer, NULL);
+    return 0;
+}
+
+// self-play between alpha-beta and MCTS, they take turns to be the attacker
+// return the number of games won by alpha-beta
+int playMatch(int games, long long timelimit)
+{
+    Board board;
+    History hist;
+    Move move;
+    Key hash;
+    int result[3] = {0, 0, 0}, winner;
+    Engine kind;
+
+    initHashTable(&table);
+    for (int g = 0; g < games; g++)
+    {
+        initBoard(&board);
+        initHistory(&hist);
+        hash = hashBoard(board, DEFENDER);
+        // draw unless anyone gets 詰み within the turns
+        winner = 2;
+        while (hist.turn < MAX_TURNS_NUM - 2)
+        {
+            kind = ((hist.turn + g) % 2) ? MONTECARLO : ALPHABETA;
+            move = computeMove(board, hist, kind, timelimit);
+            if (!move)
+            {
+                winner = (kind == ALPHABETA);
+                break;
+            }
+            hash = updateHash(board, hash, move);
+            hist.past[hist.turn++] = hash;
+            setBoard(&board, move);
+        }
+        result[winner]++;
+        printf("game %d: %s (%d turns), alphabeta %d - %d mcts, %d draws\n", g + 1,
+            (winner == 2) ? "draw" : (winner == 0) ? "alphabeta won" : "mcts won", hist.turn, result[0], result[1], result[2]);
+        fflush(stdout);
+    }
+    printMoveCache();
+
+    return result[0];
+}
+
+// print the best lines of the position after the given moves (for game review)
+// timelimit (ms) is required, nothing else ends the search
+int analyse(int lines, long long timelimit, char** moves, int count)
+{
+    static SearchInfo si;
+    Key hash;
+
+    if (timelimit <= 0)
+    {
+        fprintf(stderr, "analyse: time must be positive\n");
+        return 1;
+    }
+    initHashTable(&table);
+    initBoard(&si.board);
+    initHistory(&si.hist);
+    hash = hashBoard(si.board, DEFENDER);
+    for (int i = 0; i < count; i++)
+    {
+        if (!playMove(&si.board, &si.hist, &hash, moves[i]))
+        {
+            fprintf(stderr, "illegal move: %s\n", moves[i]);
+            return 1;
+        }
+    }
+    printBoard(si.board);
+
+    si.multipv = lines;
+    si.timelimit = timelimit;
+    si.verbose = 1;
+    si.start = getTime();
+    if (!think(&si)) printf("no legal move\n");
+    printMoveCache();
+    return 0;
+}
+
+// usage: main 1 (computer moves first) / main 0 (player moves first) [random|alphabeta|mcts]
+//        (alphabeta and mcts keep thinking while waiting for the player's input)
+//        main usi (engine protocol)
+//        main match <games> <ms per move> (alpha-beta vs MCTS)
+//        main analyse <lines> <ms> [moves ...] (best lines of the position after the moves, ms > 0)
+//        main batchbench <boards> (batched check detection against the scalar one)
+//        main fuzz <positions> [seed] (optimized move generation against the reference)
+//        main keybench <games> (collisions of zobrist keys over random self-play)
+//        main bench <file> nodes|time <budget> (alpha-beta on positions with known best moves, see bench.txt)
 int main(int argc, char** argv)
 {
-    if (argc != 2)
+    if (argc == 2 && !strcmp(argv[1], "usi")) return usiLoop();
+    if (argc >= 4 && !strcmp(argv[1], "analyse")) return analyse(atoi(argv[2]), atoll(argv[3]), argv + 4, argc - 4);
+    if (argc == 3 && !strcmp(argv[1], "batchbench"))
+    {
+        benchBatch(atoi(argv[2]));
+        return 0;
+    }
+    if (argc == 5 && !strcmp(argv[1], "bench") && (!strcmp(argv[3], "nodes") || !strcmp(argv[3], "time")))
+    {
+        return bench(argv[2], !strcmp(argv[3], "nodes") ? atoll(argv[4]) : 0, !strcmp(argv[3], "time") ? atoll(argv[4]) : 0);
+    }
+    if (argc == 3 && !strcmp(argv[1], "keybench"))
+    {
+        benchKeys(atoi(argv[2]));
+        return 0;
+    }
+    if ((argc == 3 || argc == 4) && !strcmp(argv[1], "fuzz"))
+    {
+        return fuzz(atoll(argv[2]), (argc == 4) ? strtoull(argv[3], NULL, 10) : (Key)time(NULL));
+    }
+    if (argc == 4 && !strcmp(argv[1], "match"))
+    {
+        playMatch(atoi(argv[2]), atoll(argv[3]));
+        return 0;
+    }
+    if (argc != 2 && argc != 3)
     {
         fprintf(stderr, "Usage error: argc = %d\n", argc);
         return 1;
@@ -126,9 +346,13 @@ int main(int argc, char** argv)
 
     Board board;
     History hist;
-    Move move, moves[MAX_MOVES_LEN];
+    Move move, reply = 0, moves[MAX_MOVES_LEN];
     Key hash;
     int count = 0, isCpTurn = !strcmp(argv[1], "1");
+    Engine kind = RANDOM;
+
+    if (argc == 3 && !strcmp(argv[2], "alphabeta")) kind = ALPHABETA;
+    else if (argc == 3 && !strcmp(argv[2], "mcts")) kind = MONTECARLO;
 
     initBoard(&board);
     initHistory(&hist);
@@ -142,15 +366,17 @@ int main(int argc, char** argv)
 
     srand((unsigned int)time(NULL));
 
-    while (hist.turn < MAX_TURNS_NUM)
+    while (hist.turn < MAX_TURNS_NUM - 2)
     {
         if (isCpTurn)
         {
             printf("Computer's turn:\n");
-            count = getMoveList(board, hist, moves);
+            count = getMoveListCached(board, hist, moves);
             if (count)
             {
-                move = moves[rand() % count];
+                // the reply might have been found while pondering
+                move = reply ? reply : computeMove(board, hist, kind, THINKING_TIME);
+                reply = 0;
                 printf("%s's input = ", (hist.turn % 2) ? "DEFENDER" : "ATTACKER");
             }
             else
@@ -162,7 +388,7 @@ int main(int argc, char** argv)
         else
         {
             printf("player's turn:\n");
-            count = getMoveList(board, hist, moves);
+            count = getMoveListCached(board, hist, moves);
             if (!count)
             {
                 printf("you lose!\n");
@@ -170,7 +396,10 @@ int main(int argc, char** argv)
             }
             for (int i = 0; i < count; i++) printMove(moves[i]);
             printf("%s's input = ", (hist.turn % 2) ? "DEFENDER" : "ATTACKER");
+            fflush(stdout);
+            if (kind != RANDOM) startPonder(board, hist, hash, kind);
             move = readMove(board, hist.turn % 2);
+            if (kind != RANDOM) reply = stopPonder(move);
 
             for (int i = 0; i < count; i++)
             {
@@ -193,6 +422,7 @@ int main(int argc, char** argv)
         isCpTurn = 1 - isCpTurn;
     }
 
+    if (hist.turn >= MAX_TURNS_NUM - 2) printf("draw! (out of turns)\n");
     printf("histories:\n");
     for (int i = 0; i < hist.turn; i++) printf("%03d %016llX\n", i, hist.past[i]);
 
@@ -0,0 +1,366 @@
+#include <math.h>
+#include <pthread.h>
+
+// Monte-Carlo tree search (UCT)
+// several threads descend the shared tree at once, a descending thread puts virtual losses on its path
+// so that the others spread over different leaves
+// each thread collects a batch of leaves before running their playouts and backing them up
+// the tree is kept between moves and its subtree is reused when the new position follows the old root
+
+#define MCTS_NODES (1 << 20)
+#define MAX_THREADS 16
+#define PLAYOUT_BATCH 8
+#define PLAYOUT_DEPTH 24
+#define PLAYOUT_MARGIN 200
+#define VIRTUAL_LOSS 3
+#define UCT_C 1.4
+
+// node of the search tree
+// score: sum of results (win -> 2, draw -> 1, lose -> 0) from the view of the one who made move
+// state: 0 -> not expanded, 1 -> being expanded, 2 -> expanded (children at nodes[child: child + count])
+//        3 -> left a leaf as the pool ran out of nodes
+typedef struct mctsnode
+{
+    Move move;
+    int state, child, count;
+    int visits, score;
+} MCTSNode;
+// a leaf selected by a thread, waiting for its playout
+typedef struct mctsleaf
+{
+    Board board;
+    History hist;
+    Key key;
+    int path[MAX_PLY], len, result;
+} MCTSLeaf;
+typedef struct mctsworker
+{
+    SearchInfo* si;
+    Key seed;
+    MCTSLeaf leaves[PLAYOUT_BATCH];
+} MCTSWorker;
+
+MCTSNode mctsnodes[MCTS_NODES];
+// index of the root, number of used nodes
+int mctsroot = 0, mctstop = 0;
+// position of the root
+Board mctsboard;
+History mctshist;
+Key mctskey;
+int mctsthreads = 1;
+long long playouts;
+
+void clearTree(void);
+int allocNodes(int count);
+int findRoot(Board board, History hist);
+void expandNode(MCTSNode* node, Board board, History hist);
+int selectChild(MCTSNode* node);
+void selectLeaf(MCTSLeaf* leaf, Board board, History hist, Key key);
+int playout(Board board, History hist, Key key, Key* seed);
+void backup(MCTSLeaf* leaf);
+void* mctsWorker(void* arg);
+void printTree(SearchInfo* si);
+Move mctsThink(SearchInfo* si);
+
+void clearTree(void)
+{
+    mctsroot = mctstop = 0;
+    initBoard(&mctsboard);
+    initHistory(&mctshist);
+    mctsnodes[0].state = 0;
+}
+
+// reserve count nodes in a row, return -1 when the pool runs out
+int allocNodes(int count)
+{
+    int top;
+
+    if (__atomic_load_n(&mctstop, __ATOMIC_RELAXED) + count > MCTS_NODES) return -1;
+    top = __atomic_fetch_add(&mctstop, count, __ATOMIC_RELAXED);
+    return (top + count > MCTS_NODES) ? -1 : top;
+}
+
+// move the root to the node of the given position when it follows the current root, otherwise start a new tree
+// return 1 when a subtree was reused
+int findRoot(Board board, History hist)
+{
+    Board b = mctsboard;
+    Key key = mctskey;
+    MCTSNode* node = &mctsnodes[mctsroot];
+    int t = mctshist.turn, i;
+
+    // reuse is possible when the old history is a prefix of the new one
+    if (mctstop && mctstop < MCTS_NODES / 4 * 3 && hist.turn >= t && !memcmp(hist.past, mctshist.past, sizeof(Key) * t))
+    {
+        for (; t < hist.turn && node->state == 2; t++)
+        {
+            for (i = 0; i < node->count; i++)
+            {
+                if (updateHash(b, key, mctsnodes[node->child + i].move) == hist.past[t]) break;
+            }
+            if (i == node->count) break;
+            key = hist.past[t];
+            setBoard(&b, mctsnodes[node->child + i].move);
+            node = &mctsnodes[node->child + i];
+        }
+        if (t == hist.turn && !memcmp(&b, &board, sizeof(Board)))
+        {
+            mctsroot = node - mctsnodes;
+            mctsboard = board;
+            mctshist = hist;
+            mctskey = key;
+            return 1;
+        }
+    }
+
+    mctstop = 0;
+    mctsroot = allocNodes(1);
+    memset(&mctsnodes[mctsroot], 0, sizeof(MCTSNode));
+    mctsboard = board;
+    mctshist = hist;
+    mctskey = hashBoard(board, !(hist.turn % 2));
+    return 0;
+}
+
+// generate the children of node, only one thread gets to do it
+void expandNode(MCTSNode* node, Board board, History hist)
+{
+    Move moves[MAX_MOVES_LEN];
+    int expected = 0, count, child;
+
+    if (!__atomic_compare_exchange_n(&node->state, &expected, 1, 0, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) return;
+
+    // out of nodes, the node stays a leaf without listing its moves again on every visit
+    if (__atomic_load_n(&mctstop, __ATOMIC_RELAXED) + MAX_MOVES_LEN > MCTS_NODES)
+    {
+        __atomic_store_n(&node->state, 3, __ATOMIC_RELEASE);
+        return;
+    }
+    count = getMoveListCached(board, hist, moves);
+    child = allocNodes(count);
+    if (child < 0)
+    {
+        __atomic_store_n(&node->state, 3, __ATOMIC_RELEASE);
+        return;
+    }
+    for (int i = 0; i < count; i++)
+    {
+        memset(&mctsnodes[child + i], 0, sizeof(MCTSNode));
+        mctsnodes[child + i].move = moves[i];
+    }
+    node->child = child;
+    node->count = count;
+    __atomic_store_n(&node->state, 2, __ATOMIC_RELEASE);
+}
+
+// return the offset of the child with the best upper confidence bound
+int selectChild(MCTSNode* node)
+{
+    MCTSNode* c;
+    double value, best = -1.0, logn = log((double)__atomic_load_n(&node->visits, __ATOMIC_RELAXED) + 1.0);
+    int visits, score, selected = 0;
+
+    for (int i = 0; i < node->count; i++)
+    {
+        c = &mctsnodes[node->child + i];
+        visits = __atomic_load_n(&c->visits, __ATOMIC_RELAXED);
+        score = __atomic_load_n(&c->score, __ATOMIC_RELAXED);
+        if (!visits) return i;
+        value = score / (2.0 * visits) + UCT_C * sqrt(logn / visits);
+        if (value > best)
+        {
+            best = value;
+            selected = i;
+        }
+    }
+
+    return selected;
+}
+
+// descend from the root to a leaf, putting a virtual loss on every node on the path
+void selectLeaf(MCTSLeaf* leaf, Board board, History hist, Key key)
+{
+    MCTSNode* node = &mctsnodes[mctsroot];
+    Move move;
+
+    leaf->len = 0;
+    leaf->result = -1;
+    for (;;)
+    {
+        leaf->path[leaf->len++] = node - mctsnodes;
+        __atomic_fetch_add(&node->visits, VIRTUAL_LOSS, __ATOMIC_RELAXED);
+        if (hist.turn >= MAX_TURNS_NUM - 2)
+        {
+            // draw when the game is out of turns
+            leaf->result = 1;
+            break;
+        }
+        // expand a visited leaf (the root at once)
+        if (__atomic_load_n(&node->state, __ATOMIC_ACQUIRE) != 2 && (node->visits > VIRTUAL_LOSS || leaf->len == 1))
+        {
+            expandNode(node, board, hist);
+        }
+        if (__atomic_load_n(&node->state, __ATOMIC_ACQUIRE) != 2 || leaf->len == MAX_PLY) break;
+        if (!node->count)
+        {
+            // no legal move, got 詰み
+            leaf->result = 0;
+            break;
+        }
+
+        node = &mctsnodes[node->child + selectChild(node)];
+        move = node->move;
+        key = updateHash(board, key, move);
+        hist.past[hist.turn++] = key;
+        setBoard(&board, move);
+    }
+
+    leaf->board = board;
+    leaf->hist = hist;
+    leaf->key = key;
+}
+
+// random playout from the given position, cut at PLAYOUT_DEPTH and judged by the material balance
+// return 2 (win) / 1 (draw) / 0 (lose) from the view of the one who is about to make the next move
+int playout(Board board, History hist, Key key, Key* seed)
+{
+    Move move, moves[MAX_MOVES_LEN];
+    int player = hist.turn % 2, count, score;
+
+    for (int i = 0; i < PLAYOUT_DEPTH; i++)
+    {
+        if (hist.turn >= MAX_TURNS_NUM - 2) return 1;
+        count = getMoveListCached(board, hist, moves);
+        if (!count) return (hist.turn % 2 == player) ? 0 : 2;
+        move = moves[nextRandom(seed) % count];
+        key = updateHash(board, key, move);
+        hist.past[hist.turn++] = key;
+        setBoard(&board, move);
+    }
+
+    score = evaluate(board, player);
+    return (score > PLAYOUT_MARGIN) ? 2 : (score < -PLAYOUT_MARGIN) ? 0 : 1;
+}
+
+// remove the virtual losses on the path and add the result of the leaf
+void backup(MCTSLeaf* leaf)
+{
+    // result of the leaf is from the view of the one to move there, which is the competitor of the one who made it
+    int result = 2 - leaf->result;
+
+    for (int i = leaf->len - 1; i >= 0; i--, result = 2 - result)
+    {
+        __atomic_fetch_add(&mctsnodes[leaf->path[i]].visits, 1 - VIRTUAL_LOSS, __ATOMIC_RELAXED);
+        __atomic_fetch_add(&mctsnodes[leaf->path[i]].score, result, __ATOMIC_RELAXED);
+    }
+}
+
+// entry of a search thread
+void* mctsWorker(void* arg)
+{
+    MCTSWorker* w = (MCTSWorker*)arg;
+    MCTSLeaf* leaf;
+
+    while (!w->si->stop)
+    {
+        for (int i = 0; i < PLAYOUT_BATCH; i++) selectLeaf(&w->leaves[i], mctsboard, mctshist, mctskey);
+        for (int i = 0; i < PLAYOUT_BATCH; i++)
+        {
+            leaf = &w->leaves[i];
+            if (leaf->result < 0) leaf->result = playout(leaf->board, leaf->hist, leaf->key, &w->seed);
+            backup(leaf);
+        }
+        __atomic_fetch_add(&playouts, PLAYOUT_BATCH, __ATOMIC_RELAXED);
+    }
+
+    return NULL;
+}
+
+// follow the most visited children from the root as principal variation and report it
+void printTree(SearchInfo* si)
+{
+    MCTSNode *node = &mctsnodes[mctsroot], *best;
+    char line[1024], str[6];
+    long long elapsed = getTime() - si->start, n = __atomic_load_n(&playouts, __ATOMIC_RELAXED);
+    int len;
+
+    si->pvlen[0] = 0;
+    while (__atomic_load_n(&node->state, __ATOMIC_ACQUIRE) == 2 && node->count && si->pvlen[0] < MAX_PLY)
+    {
+        best = &mctsnodes[node->child];
+        for (int i = 1; i < node->count; i++)
+        {
+            if (mctsnodes[node->child + i].visits > best->visits) best = &mctsnodes[node->child + i];
+        }
+        if (!best->visits) break;
+        si->pv[0][si->pvlen[0]++] = best->move;
+        node = best;
+    }
+    if (!si->pvlen[0]) return;
+
+    // winning rate of the root move in centipawn-like scale
+    node = &mctsnodes[mctsnodes[mctsroot].child];
+    for (int i = 0; i < mctsnodes[mctsroot].count; i++, node++) if (node->move == si->pv[0][0]) break;
+    double rate = (node->score + 1.0) / (2.0 * node->visits + 2.0);
+    si->score = (int)(-400.0 * log10(1.0 / rate - 1.0));
+    si->best = si->pv[0][0];
+    si->ponder = (si->pvlen[0] > 1) ? si->pv[0][1] : 0;
+    si->nodes = n;
+    if (!si->verbose) return;
+
+    len = sprintf(line, "info depth %d score cp %d nodes %lld nps %lld time %lld pv",
+        si->pvlen[0], si->score, n, n * 1000 / (elapsed + 1), elapsed);
+    for (int i = 0; i < si->pvlen[0]; i++) len += sprintf(line + len, " %s", formatMove(si->pv[0][i], str));
+    printf("%s\n", line);
+    fflush(stdout);
+}
+
+// search the root position in si with mctsthreads threads until stopped
+// si->maxnodes limits the number of playouts
+// return the most visited move (0 when there is no legal move)
+Move mctsThink(SearchInfo* si)
+{
+    MCTSWorker workers[MAX_THREADS];
+    pthread_t threads[MAX_THREADS];
+    Move moves[MAX_MOVES_LEN];
+    int reused, count = (mctsthreads < 1) ? 1 : (mctsthreads > MAX_THREADS) ? MAX_THREADS : mctsthreads;
+    long long last = si->start;
+
+    si->best = si->ponder = 0;
+    si->score = 0;
+    if (!getMoveListCached(si->board, si->hist, moves)) return 0;
+    si->best = moves[0];
+
+    reused = findRoot(si->board, si->hist);
+    playouts = 0;
+    for (int i = 0; i < count; i++)
+    {
+        workers[i].si = si;
+        workers[i].seed = (Key)i * 0x9E3779B97F4A7C15 ^ si->hist.turn;
+        pthread_create(&threads[i], NULL, mctsWorker, &workers[i]);
+    }
+
+    while (!si->stop)
+    {
+        nanosleep(&(struct timespec){0, 1000000}, NULL);
+        if (!si->pondering && si->maxnodes && playouts >= si->maxnodes) si->stop = 1;
+        if (!si->pondering && si->timelimit && getTime() - si->start >= si->timelimit) si->stop = 1;
+        if (getTime() - last >= 1000)
+        {
+            last = getTime();
+            printTree(si);
+        }
+    }
+    for (int i = 0; i < count; i++) pthread_join(threads[i], NULL);
+
+    printTree(si);
+    if (si->verbose)
+    {
+        long long elapsed = getTime() - si->start;
+        printf("info string mcts playouts %lld (%lld playouts/s) threads %d tree %d nodes%s\n",
+            playouts, playouts * 1000 / (elapsed + 1), count, mctstop, reused ? " (reused)" : "");
+        fflush(stdout);
+    }
+
+    return si->best;
+}
@@ -0,0 +1,130 @@
+// cache of legal move lists
+// the same positions get their moves listed again and again
+// (the interactive loop and the ponderer, playMove, the pawn drop mate test, revisits in search and MCTS)
+// a position is identified by its board, the player to move and the part of the history the rules look at
+// the cache is a fixed set-associative table, each set is replaced by the clock algorithm
+// and guarded by its own spinlock, as MCTS threads share it
+// lists are generated by getMoveListFast while the set is unlocked, so the generation may come back here
+
+#define MOVE_CACHE_SETS (1 << 12)
+#define MOVE_CACHE_WAYS 4
+// longer lists are not cached
+#define MOVE_CACHE_LEN 120
+#define CONTEXT_TABLE_SIZE 256
+
+// context: 0 or the mix of the history (see getHistoryContext)
+// an empty slot has a zero board, which is no position
+// used: reference bit of the clock
+typedef struct movecacheslot
+{
+    Key key, context;
+    Board board;
+    short count;
+    char player, used;
+    Move moves[MOVE_CACHE_LEN];
+} MoveCacheSlot;
+typedef struct movecacheset
+{
+    char lock, hand;
+    MoveCacheSlot slots[MOVE_CACHE_WAYS];
+} MoveCacheSet;
+
+MoveCacheSet movecache[MOVE_CACHE_SETS];
+long long movecachehits, movecachemisses;
+
+void clearMoveCache(void);
+Key getHistoryContext(History* hist);
+int findCachedMoves(MoveCacheSlot* slot, Key key, Key context, Board board, int player);
+int getMoveListCached(Board board, History hist, Move* moves);
+void printMoveCache(void);
+
+void clearMoveCache(void)
+{
+    memset(movecache, 0, sizeof(movecache));
+    movecachehits = movecachemisses = 0;
+}
+
+// a move is a repetition when its board has been made 3 times before by the same player
+// and the pawn drop mate test adds at most 1 board of each player to the history
+// so only boards which have appeared twice or more can matter
+// return 0 when there is no such board (the moves then depend on the board alone)
+// else a mix of the whole history
+Key getHistoryContext(History* hist)
+{
+    Key seen[CONTEXT_TABLE_SIZE] = {0}, context = 0;
+    int repeated = 0, h;
+
+    // open addressing on the keys, the parity of the turn is already in the key
+    for (int i = 0; i < hist->turn && !repeated; i++)
+    {
+        for (h = (hist->past[i] >> 1) % CONTEXT_TABLE_SIZE; seen[h] && seen[h] != hist->past[i]; h = (h + 1) % CONTEXT_TABLE_SIZE);
+        repeated = seen[h] == hist->past[i];
+        seen[h] = hist->past[i];
+    }
+    if (!repeated) return 0;
+
+    for (int i = 0; i < hist->turn; i++) context = (context ^ hist->past[i]) * 0x9E3779B97F4A7C15;
+    return context | 1;
+}
+
+int findCachedMoves(MoveCacheSlot* slot, Key key, Key context, Board board, int player)
+{
+    return slot->key == key && slot->context == context && slot->player == player &&
+        slot->board.attacker == board.attacker && slot->board.defender == board.defender;
+}
+
+// same as getMoveList
+int getMoveListCached(Board board, History hist, Move* moves)
+{
+    int player = hist.turn % 2, count, w;
+    // past[turn - 1] is the key of this board unless it is the initial one
+    Key key = hist.turn ? hist.past[hist.turn - 1] : hashBoardFast(board, !player);
+    Key context = getHistoryContext(&hist);
+    MoveCacheSet* set = &movecache[(key >> 1) % MOVE_CACHE_SETS];
+    MoveCacheSlot* slot;
+
+    while (__atomic_test_and_set(&set->lock, __ATOMIC_ACQUIRE));
+    for (w = 0; w < MOVE_CACHE_WAYS; w++)
+    {
+        slot = &set->slots[w];
+        if (!findCachedMoves(slot, key, context, board, player)) continue;
+        count = slot->count;
+        memcpy(moves, slot->moves, sizeof(Move) * count);
+        slot->used = 1;
+        __atomic_clear(&set->lock, __ATOMIC_RELEASE);
+        __atomic_fetch_add(&movecachehits, 1, __ATOMIC_RELAXED);
+        return count;
+    }
+    __atomic_clear(&set->lock, __ATOMIC_RELEASE);
+
+    __atomic_fetch_add(&movecachemisses, 1, __ATOMIC_RELAXED);
+    count = getMoveListFast(board, hist, moves);
+    if (count > MOVE_CACHE_LEN) return count;
+
+    while (__atomic_test_and_set(&set->lock, __ATOMIC_ACQUIRE));
+    // the clock hand passes over recently used slots once, clearing their bits
+    for (w = 0; w < MOVE_CACHE_WAYS && !findCachedMoves(&set->slots[w], key, context, board, player); w++);
+    if (w == MOVE_CACHE_WAYS)
+    {
+        while (set->slots[(int)set->hand].used) set->slots[(int)set->hand].used = 0, set->hand = (set->hand + 1) % MOVE_CACHE_WAYS;
+        slot = &set->slots[(int)set->hand];
+        set->hand = (set->hand + 1) % MOVE_CACHE_WAYS;
+        slot->key = key;
+        slot->context = context;
+        slot->board = board;
+        slot->player = player;
+        slot->count = count;
+        slot->used = 0;
+        memcpy(slot->moves, moves, sizeof(Move) * count);
+    }
+    __atomic_clear(&set->lock, __ATOMIC_RELEASE);
+
+    return count;
+}
+
+void printMoveCache(void)
+{
+    long long hits = __atomic_load_n(&movecachehits, __ATOMIC_RELAXED), misses = __atomic_load_n(&movecachemisses, __ATOMIC_RELAXED);
+
+    printf("move cache: %lld hits, %lld misses (%.1f%% hit)\n", hits, misses, 100.0 * hits / (hits + misses + !(hits + misses)));
+}
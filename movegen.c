@@ -0,0 +1,178 @@
+// faster move generation on monoboards
+// the reference functions in simulator.c find checks through getMovableMap and makeStep for every piece
+// and rehash the whole board for every repetition test
+// here checks come from getAttackMap and children are hashed incrementally
+// the rules and even the order of moves are the same as getMoveList, which fuzz.c keeps verifying
+
+MonoBoard getOccupiedMap(Board board, int player);
+int isCheckedFast(Board board, int player);
+Key hashBoardFast(Board board, int player);
+Key updateHashFast(Board board, Key hash, Move move);
+int isDecidableMoveFast(Board board, History hist, Move move);
+MonoBoard getPlacableMapFast(Board board, History hist, Piece piece, int player);
+int getMoveListFast(Board board, History hist, Move* moves);
+// in movecache.c
+int getMoveListCached(Board board, History hist, Move* moves);
+
+// return a monoboard with the pos of player's on-board pieces marked
+MonoBoard getOccupiedMap(Board board, int player)
+{
+    MonoBoard map = 0x0;
+    Pos* p = (Pos*)&board;
+
+    for (int i = PAWN; i <= KING; i++, p++)
+    {
+        for (int j = 0; j < 9; j += 8)
+        {
+            if (*(p + j) == player * 0xFF || getPlayer(*(p + j)) != player) continue;
+            map |= 1 << pos2idx(*(p + j));
+        }
+    }
+
+    return map;
+}
+
+// same as isChecked
+int isCheckedFast(Board board, int player)
+{
+    Pos king = (getPiece(board, KING) >> (player == ATTACKER ? 0 : 8)) & 0xFF, pos;
+    Pos* p = (Pos*)&board;
+    MonoBoard empty = FULL_MAP & ~(getOccupiedMap(board, ATTACKER) | getOccupiedMap(board, DEFENDER));
+    MonoBoard target = 1 << pos2idx(king);
+
+    for (int i = PAWN; i <= KING; i++, p++)
+    {
+        for (int j = 0; j < 9; j += 8)
+        {
+            pos = *(p + j);
+            if (getPlayer(pos) == player || pos == !player * 0xFF) continue;
+            if (getAttackMap(pos, i, empty) & target) return 1;
+        }
+    }
+
+    return 0;
+}
+
+// same as hashBoard
+Key hashBoardFast(Board board, int player)
+{
+    Key hash = (player == ATTACKER) ? table.attacker : table.defender;
+
+    for (int i = PAWN; i <= KING; i++) hash ^= hashPieceType(board, i);
+
+    return hash ^ (isCheckedFast(board, !player) ? (Key)1 : (Key)0);
+}
+
+// same as updateHash
+Key updateHashFast(Board board, Key hash, Move move)
+{
+    Board next = board;
+    int player = getPlayer(move), moved, taken = -1;
+
+    if ((move >> 8) < KING)
+    {
+        moved = move >> 8;
+    }
+    else
+    {
+        moved = getPos(board, move >> 8) % 8;
+        taken = getPos(board, move & 0xFF);
+    }
+    setBoard(&next, move);
+
+    hash = (hash & ~(Key)1) ^ table.attacker ^ table.defender;
+    hash ^= hashPieceType(board, moved) ^ hashPieceType(next, moved);
+    if (taken != -1 && taken % 8 != moved) hash ^= hashPieceType(board, taken % 8) ^ hashPieceType(next, taken % 8);
+
+    return hash ^ (isCheckedFast(next, !player) ? (Key)1 : (Key)0);
+}
+
+// same as isDecidableMove
+int isDecidableMoveFast(Board board, History hist, Move move)
+{
+    Move moves[MAX_MOVES_LEN];
+
+    setBoard(&board, move);
+    hist.past[hist.turn] = hashBoardFast(board, hist.turn % 2); hist.turn++;
+    if (!isCheckedFast(board, hist.turn % 2)) return 0;
+    // the same drops get tested again and again, past[turn - 1] is already the key of the board
+    return !getMoveListCached(board, hist, moves);
+}
+
+// same as getPlacableMap
+MonoBoard getPlacableMapFast(Board board, History hist, Piece piece, int player)
+{
+    MonoBoard placablemap = FULL_MAP & ~(getOccupiedMap(board, ATTACKER) | getOccupiedMap(board, DEFENDER));
+    if (piece != PAWN) return placablemap;
+    int pos = getPiece(board, piece), shift;
+    if ((pos >> 8) == player * 0xFF) pos &= 0xFF;
+    else if ((pos & 0xFF) == player * 0xFF) pos >>= 8;
+    // 二歩
+    if (getPlayer(pos) == player && !isPromoted(pos) && pos != player * 0xFF)
+    {
+        shift = (int)(pos & 0xF) - (player == ATTACKER ? 0x1 : 0xA);
+        placablemap &= ~(0x108421 << shift);
+    }
+    // 陣地
+    placablemap &= ~(player == ATTACKER ? 0x1F00000 : 0x1F);
+    // 打ち歩詰め
+    for (int i = 0; i < 25; i++)
+    {
+        if (!(placablemap & (1 << i))) continue;
+        if (isDecidableMoveFast(board, hist, idx2pos(i, player))) placablemap &= ~(1 << i);
+    }
+
+    return placablemap;
+}
+
+// same as getMoveList
+int getMoveListFast(Board board, History hist, Move* moves)
+{
+    int counter = 0, player = hist.turn % 2, rep;
+    Pos* p = (Pos*)&board, pos;
+    Move move;
+    Key hash = hashBoardFast(board, !player);
+    MonoBoard markedmap, own = getOccupiedMap(board, player);
+    MonoBoard empty = FULL_MAP & ~(own | getOccupiedMap(board, !player));
+    Board after;
+
+    for (int i = PAWN; i <= KING; i++, p++)
+    {
+        for (int j = 0; j < 9; j += 8)
+        {
+            pos = *(p + j);
+            if (getPlayer(pos) != player) continue;
+
+            if (pos == player * 0xFF)
+            {
+                pos = i;
+                markedmap = getPlacableMapFast(board, hist, i, player);
+            }
+            else
+            {
+                markedmap = getAttackMap(pos, i, empty) & ~own;
+            }
+            for (int k = 0; k < 25; k++)
+            {
+                if (!(markedmap & (1 << k))) continue;
+                move = pos << 8 | (isPromoted(pos) ? pos2promoted(idx2pos(k, player)) : idx2pos(k, player));
+                after = board;
+                setBoard(&after, move);
+                if (isCheckedFast(after, player)) continue;
+                rep = getRepetition(&hist, updateHashFast(board, hash, move));
+                if (player == ATTACKER && rep) continue;
+                if (rep == 2) continue;
+                if (!(isPromotableMove(board, move) && i == PAWN))
+                {
+                    *(moves + counter++) = move;
+                }
+                if (isPromotableMove(board, move))
+                {
+                    *(moves + counter++) = pos << 8 | pos2promoted(move & 0xFF);
+                }
+            }
+        }
+    }
+
+    return counter;
+}
@@ -0,0 +1,284 @@
+#define MATE_SCORE 30000
+#define INF_SCORE 32000
+#define MAX_PLY 64
+#define TT_SIZE (1 << 20)
+#define MAX_MULTIPV 8
+
+// bound type of a stored score
+typedef enum bound { EXACT = 0, LOWER, UPPER } Bound;
+// kind of the computer player (random, this alpha-beta search or MCTS in mcts.c)
+typedef enum engine { RANDOM = 0, ALPHABETA, MONTECARLO } Engine;
+// entry of transposition table
+typedef struct ttentry
+{
+    Key key;
+    int score;
+    Move move;
+    char depth, bound;
+} TTEntry;
+// struct of a running search
+// stop may be raised by another thread (command reader) at any time
+// while pondering, the time and node limits are ignored until it gets cleared
+// multipv: number of best root moves to report, line[k] is the principal variation of the (k + 1)th best move
+// excluded: number of lines already found in the current iteration, their first moves are skipped at the root
+// iterbest, iternodes, itertime: best move, nodes and elapsed ms at the end of each finished iteration (by depth)
+typedef struct searchinfo
+{
+    Board board;
+    History hist;
+    int maxdepth, multipv, excluded;
+    long long maxnodes, timelimit;
+    volatile int stop, pondering, infinite;
+    int verbose;
+    long long start, nodes;
+    int depth, score;
+    Move best, ponder;
+    Move pv[MAX_PLY][MAX_PLY];
+    int pvlen[MAX_PLY];
+    Move line[MAX_MULTIPV][MAX_PLY];
+    int linelen[MAX_MULTIPV], linescore[MAX_MULTIPV];
+    Move iterbest[MAX_PLY];
+    long long iternodes[MAX_PLY], itertime[MAX_PLY];
+} SearchInfo;
+
+// transposition table shared between searches
+TTEntry tt[TT_SIZE];
+
+// value of a piece on board (unpromoted, promoted) and off board
+int piecevalue[2][6] = {
+    {100, 1000, 800, 500, 600, 0},
+    {700, 1300, 1100, 600, 600, 0}
+};
+int handvalue[6] = {120, 1100, 900, 550, 650, 0};
+
+void clearTable(void);
+int evaluate(Board board, int player);
+int scoreMove(Board board, Move move, Move ttmove);
+void orderMoves(Board board, Move* moves, int count, Move ttmove);
+int isExcluded(SearchInfo* si, Move move);
+int searchNode(SearchInfo* si, Board board, History* hist, Key key, int depth, int alpha, int beta, int ply);
+void printInfo(SearchInfo* si, int k);
+Move think(SearchInfo* si);
+
+void clearTable(void) { memset(tt, 0, sizeof(tt)); }
+
+// return the material balance from the view of player
+int evaluate(Board board, int player)
+{
+    Pos* p = (Pos*)&board, pos;
+    int score = 0, value;
+
+    for (int i = PAWN; i < KING; i++, p++)
+    {
+        for (int j = 0; j < 9; j += 8)
+        {
+            pos = *(p + j);
+            value = (pos == 0x00 || pos == 0xFF) ? handvalue[i] : piecevalue[isPromoted(pos)][i];
+            score += (getPlayer(pos) == player) ? value : -value;
+        }
+    }
+
+    return score;
+}
+
+// ordering key of a move: move from transposition table -> taking -> promotion -> others
+int scoreMove(Board board, Move move, Move ttmove)
+{
+    int taken;
+
+    if (move == ttmove) return 1 << 16;
+    if ((move >> 8) < KING) return 0;
+    taken = getPos(board, move & 0xFF);
+    if (taken != -1) return 1 << 12 | piecevalue[isPromoted(((Pos*)&board)[taken])][taken % 8];
+    return isPromoted(move >> 8) ^ isPromoted(move & 0xFF);
+}
+
+// sort moves in place by scoreMove (insertion sort, the list is short)
+void orderMoves(Board board, Move* moves, int count, Move ttmove)
+{
+    int scores[MAX_MOVES_LEN], score;
+    Move move;
+
+    for (int i = 0; i < count; i++)
+    {
+        move = moves[i];
+        score = scoreMove(board, move, ttmove);
+        int j = i;
+        for (; j > 0 && scores[j - 1] < score; j--)
+        {
+            moves[j] = moves[j - 1];
+            scores[j] = scores[j - 1];
+        }
+        moves[j] = move;
+        scores[j] = score;
+    }
+}
+
+// return 1 when the given root move heads a line already found in the current iteration else 0
+int isExcluded(SearchInfo* si, Move move)
+{
+    for (int k = 0; k < si->excluded; k++) if (si->line[k][0] == move) return 1;
+    return 0;
+}
+
+// negamax alpha-beta search
+// key: hashed value of board (same as hist->past[hist->turn - 1] when turn > 0)
+// return the score from the view of the one who is about to make the next move
+int searchNode(SearchInfo* si, Board board, History* hist, Key key, int depth, int alpha, int beta, int ply)
+{
+    Move moves[MAX_MOVES_LEN], ttmove = 0, bestmove = 0;
+    TTEntry* entry = &tt[key & (TT_SIZE - 1)];
+    Board next;
+    Key nextkey;
+    int count, score, best = -INF_SCORE, origin = alpha;
+
+    si->pvlen[ply] = 0;
+    if (!si->pondering && si->maxnodes && si->nodes >= si->maxnodes) si->stop = 1;
+    if (!si->pondering && si->timelimit && !(si->nodes & 0x3FF) && getTime() - si->start >= si->timelimit) si->stop = 1;
+    if (si->stop) return 0;
+    si->nodes++;
+
+    // draw when the game is out of turns
+    if (ply && hist->turn >= MAX_TURNS_NUM - 2) return 0;
+    if (depth <= 0 || ply >= MAX_PLY - 1) return evaluate(board, hist->turn % 2);
+
+    if (entry->key == key)
+    {
+        ttmove = entry->move;
+        score = entry->score;
+        // mate scores are stored relative to the node
+        if (score > MATE_SCORE - MAX_PLY) score -= ply;
+        else if (score < -MATE_SCORE + MAX_PLY) score += ply;
+        if (ply && entry->depth >= depth)
+        {
+            if (entry->bound == EXACT)
+            {
+                // keep the stored move as the head of the truncated principal variation
+                si->pv[ply][0] = ttmove;
+                si->pvlen[ply] = !!ttmove;
+                return score;
+            }
+            if (entry->bound == LOWER && score >= beta) return score;
+            if (entry->bound == UPPER && score <= alpha) return score;
+        }
+    }
+
+    count = getMoveListCached(board, *hist, moves);
+    // no legal move, got 詰み
+    if (!count) return -MATE_SCORE + ply;
+    orderMoves(board, moves, count, ttmove);
+
+    for (int i = 0; i < count; i++)
+    {
+        if (!ply && isExcluded(si, moves[i])) continue;
+        next = board;
+        setBoard(&next, moves[i]);
+        nextkey = updateHash(board, key, moves[i]);
+        hist->past[hist->turn++] = nextkey;
+        score = -searchNode(si, next, hist, nextkey, depth - 1, -beta, -alpha, ply + 1);
+        hist->turn--;
+        if (si->stop) return 0;
+
+        if (score > best)
+        {
+            best = score;
+            bestmove = moves[i];
+        }
+        if (score > alpha)
+        {
+            alpha = score;
+            // collect principal variation
+            si->pv[ply][0] = moves[i];
+            memcpy(si->pv[ply] + 1, si->pv[ply + 1], sizeof(Move) * si->pvlen[ply + 1]);
+            si->pvlen[ply] = si->pvlen[ply + 1] + 1;
+        }
+        if (alpha >= beta) break;
+    }
+
+    // the score of a root with excluded moves is not the score of the position
+    if (!ply && si->excluded) return best;
+
+    entry->key = key;
+    entry->move = bestmove;
+    entry->depth = depth;
+    entry->bound = (best >= beta) ? LOWER : (best > origin) ? EXACT : UPPER;
+    entry->score = best;
+    if (best > MATE_SCORE - MAX_PLY) entry->score += ply;
+    else if (best < -MATE_SCORE + MAX_PLY) entry->score -= ply;
+
+    return best;
+}
+
+// print the kth line of the current iteration
+void printInfo(SearchInfo* si, int k)
+{
+    char line[1024], str[6];
+    long long elapsed = getTime() - si->start;
+    int len, score = si->linescore[k];
+
+    len = sprintf(line, "info depth %d", si->depth);
+    if (si->multipv > 1) len += sprintf(line + len, " multipv %d", k + 1);
+    if (score > MATE_SCORE - MAX_PLY) len += sprintf(line + len, " score mate %d", MATE_SCORE - score);
+    else if (score < -MATE_SCORE + MAX_PLY) len += sprintf(line + len, " score mate -%d", MATE_SCORE + score);
+    else len += sprintf(line + len, " score cp %d", score);
+    len += sprintf(line + len, " nodes %lld nps %lld time %lld pv", si->nodes, si->nodes * 1000 / (elapsed + 1), elapsed);
+    for (int i = 0; i < si->linelen[k]; i++) len += sprintf(line + len, " %s", formatMove(si->line[k][i], str));
+    printf("%s\n", line);
+    fflush(stdout);
+}
+
+// iterative deepening from the root position in si
+// each iteration searches the root si->multipv times, skipping the moves of the lines found before
+// so the later lines are cheap thanks to the transposition table filled by the former ones
+// return the best move of the last finished iteration (0 when there is no legal move)
+Move think(SearchInfo* si)
+{
+    Move moves[MAX_MOVES_LEN];
+    History hist = si->hist;
+    Key key = hashBoard(si->board, !(hist.turn % 2));
+    int score, maxdepth = (si->maxdepth > 0 && si->maxdepth < MAX_PLY) ? si->maxdepth : MAX_PLY - 1;
+
+    si->nodes = 0;
+    si->depth = si->score = 0;
+    si->best = si->ponder = 0;
+    if (si->multipv < 1) si->multipv = 1;
+    if (si->multipv > MAX_MULTIPV) si->multipv = MAX_MULTIPV;
+    if (!getMoveListCached(si->board, hist, moves)) return 0;
+    // fallback in case that even the first iteration gets stopped
+    si->best = moves[0];
+
+    for (int depth = 1; depth <= maxdepth; depth++)
+    {
+        for (int k = 0; k < si->multipv; k++)
+        {
+            si->excluded = k;
+            score = searchNode(si, si->board, &hist, key, depth, -INF_SCORE, INF_SCORE, 0);
+            // stopped, or fewer legal moves than lines
+            if (si->stop || !si->pvlen[0]) break;
+
+            memcpy(si->line[k], si->pv[0], sizeof(Move) * si->pvlen[0]);
+            si->linelen[k] = si->pvlen[0];
+            si->linescore[k] = score;
+            if (!k)
+            {
+                si->depth = depth;
+                si->score = score;
+                si->best = si->pv[0][0];
+                si->ponder = (si->pvlen[0] > 1) ? si->pv[0][1] : 0;
+            }
+            if (si->verbose) printInfo(si, k);
+        }
+        si->excluded = 0;
+        if (si->stop) break;
+        si->iterbest[depth] = si->best;
+        si->iternodes[depth] = si->nodes;
+        si->itertime[depth] = getTime() - si->start;
+
+        // mate has been found
+        if (si->multipv == 1 && (si->score > MATE_SCORE - MAX_PLY || si->score < -MATE_SCORE + MAX_PLY)) break;
+        // another iteration would hardly finish in the left time
+        if (!si->pondering && si->timelimit && (getTime() - si->start) * 2 > si->timelimit) break;
+    }
+
+    return si->best;
+}
@@ -9,6 +9,8 @@
 #define MAX_TURNS_NUM 150
 #define KEY_TABLE_ROW 20
 #define KEY_TABLE_COL 27
+// fixed seed of zobrist keys, so that hashed values stored in files stay valid across runs
+#define KEY_SEED 0x2020B0A2D5A1E5ULL
 
 // enum of piece type (also equals to it's address offset from &Board)
 // offsets of attacker's pieces: 0-6
@@ -63,22 +65,34 @@ int convert2alpha(int p) { return (p > 0x7) ? p : (p + 0x9); }
 // swich the half-pos expression between digit and alphabet: 1 -> A -> 1
 int convert2opposite(int p) { return p + ((p < 0x7) ? 0x9 : -0x9); }
 
-// 1st bit for checked mark, left 63bits for random hash key
-Key genKey(void)
+// splitmix64, a seedable 64bit pseudo random generator (state is advanced in place)
+Key nextRandom(Key* state)
+{
+    Key z = (*state += 0x9E3779B97F4A7C15);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EB;
+    return z ^ (z >> 31);
+}
+
+// monotonic clock in milliseconds
+long long getTime(void)
 {
-    return (Key)(~1) &
-        ((Key)rand() << 0x00) & 0x000000000000FFFF |
-        ((Key)rand() << 0x10) & 0x00000000FFFF0000 |
-        ((Key)rand() << 0x20) & 0x0000FFFF00000000 |
-        ((Key)rand() << 0x30) & 0xFFFF000000000000;
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
 }
 
+// 1st bit for checked mark, left 63bits for random hash key
+Key genKey(Key* state) { return nextRandom(state) & ~(Key)1; }
+
 void initBoard(Board* bp);
 void initHashTable(HashTable* table);
 void initHistory(History* hist);
 
 MonoBoard monoizeBoard(Board board, int hide);
+Key hashPieceType(Board board, Piece piece);
 Key hashBoard(Board board, int player);
+Key updateHash(Board board, Key hash, Move move);
 
 Pos pos2digit(Pos pos);
 Pos pos2alpha(Pos pos);
@@ -89,7 +103,9 @@ Pos posImport(Pos pos, int player);
 Pos posExport(Pos pos);
 
 int hashPiece(const char* piece);
+Move parseMove(Board board, int player, const char* input);
 Move readMove(Board board, int player);
+char* formatMove(Move move, char* str);
 void printMove(Move move);
 
 int isValidPos(Pos pos);
@@ -99,6 +115,7 @@ int isChecked(Board board, int player);
 int isCheckedMove(Board board, Move move);
 int isDecidableMove(Board board, History hist, Move move);
 int isRepetitiveMove(Board board, History hist, Move move);
+int getRepetition(History* hist, Key hash);
 
 int getPlayer(Move move);
 int getPos(Board board, Pos pos);
@@ -129,13 +146,14 @@ void initBoard(Board* bp)
 // row index: attacker's pawn - king (0 - 5), promoted pawn - promoted silver (6 - 9)
 //            defender's pawn - king (10 - 15), promoted pawn - promoted silver (16 - 19)
 // col index: on-board state (0 - 24), off-board state (1 in hand -> 25, 2 in hand -> 26)
+// keys are drawn from nextRandom seeded by KEY_SEED, the same on every run
 void initHashTable(HashTable* table)
 {
     Key* k = (Key*)table->keys;
-    srand((unsigned int)time(NULL));
-    table->attacker = genKey();
-    table->defender = genKey();
-    for (int i = 0; i < KEY_TABLE_ROW * KEY_TABLE_COL; i++) *(k + i) = genKey();
+    Key state = KEY_SEED;
+    table->attacker = genKey(&state);
+    table->defender = genKey(&state);
+    for (int i = 0; i < KEY_TABLE_ROW * KEY_TABLE_COL; i++) *(k + i) = genKey(&state);
 }
 
 // init history stuct
@@ -163,21 +181,53 @@ MonoBoard monoizeBoard(Board board, int hide)
     return monoboard;
 }
 
+// return the part of the hashed value contributed by both pieces of the given type
+Key hashPieceType(Board board, Piece piece)
+{
+    Pos* p = (Pos*)&board + piece;
+
+    // 2 piece off-board
+    if (getPiece(board, piece) == getPlayer(*p) * 0xFFFF) return table.keys[piece + getPlayer(*p) * 10][26];
+    return table.keys[piece + getPlayer(*p) * 10 + isPromoted(*p) * 6][pos2idx(*p)] ^
+        table.keys[piece + getPlayer(*(p + 8)) * 10 + isPromoted(*(p + 8)) * 6][pos2idx(*(p + 8))];
+}
+
 // return the hashed value of board basing on Zobrist Hashing
 Key hashBoard(Board board, int player)
 {
     Key hash = (player == ATTACKER) ? table.attacker : table.defender;
-    Pos* p = (Pos*)&board;
 
-    for (int i = PAWN; i <= KING; i++, p++)
+    for (int i = PAWN; i <= KING; i++) hash ^= hashPieceType(board, i);
+
+    return hash ^ (isChecked(board, !player) ? (Key)1 : (Key)0);
+}
+
+// return the hashed value of board after applying the given move (legal move supposed)
+// hash: hashed value of board before the move, from the view of the competitor of the one who makes the move
+// only the moved piece and the taken piece are rehashed, the result equals to hashBoard(next board, player)
+Key updateHash(Board board, Key hash, Move move)
+{
+    Board next = board;
+    int player = getPlayer(move), moved, taken = -1;
+
+    if ((move >> 8) < KING)
+    {
+        // placement of a off-board piece
+        moved = move >> 8;
+    }
+    else
     {
-        // 2 piece off-board
-        if (getPiece(board, i) == getPlayer(*p) * 0xFFFF) { hash ^= table.keys[i + getPlayer(*p) * 10][26]; continue; }
-        hash ^= table.keys[i + getPlayer(*p) * 10 + isPromoted(*p) * 6][pos2idx(*p)];
-        hash ^= table.keys[i + getPlayer(*(p + 8)) * 10 + isPromoted(*(p + 8)) * 6][pos2idx(*(p + 8))];
+        moved = getPos(board, move >> 8) % 8;
+        taken = getPos(board, move & 0xFF);
     }
+    setBoard(&next, move);
 
-    return hash ^ (isChecked(board, !player) ? (Key)1 : (Key)0);
+    // clear the checked mark and switch the side
+    hash = (hash & ~(Key)1) ^ table.attacker ^ table.defender;
+    hash ^= hashPieceType(board, moved) ^ hashPieceType(next, moved);
+    if (taken != -1 && taken % 8 != moved) hash ^= hashPieceType(board, taken % 8) ^ hashPieceType(next, taken % 8);
+
+    return hash ^ (isChecked(next, !player) ? (Key)1 : (Key)0);
 }
 
 // return a pos-expression of given pos in digit
@@ -232,32 +282,34 @@ int hashPiece(const char* piece)
     }
 }
 
-// parse the input instruction
-Move readMove(Board board, int player)
+// parse a formal instruction (in the notation of printMove)
+// return 0 (no legal move) when the input is malformed or no piece stands on the source pos
+Move parseMove(Board board, int player, const char* input)
 {
-    char input[6], piece[3];
-    int from, to;
-    scanf("%s", input);
+    char piece[3];
+    int from, to, place;
 
+    if (strlen(input) != 4 && strlen(input) != 5) return 0;
     if (strlen(input) == 5)
     {
         // movement with promotion
-        sscanf(input, "%2X%2X%*c", &from, &to);
+        if (sscanf(input, "%2X%2X%*c", &from, &to) != 2) return 0;
         return posImport(from, player) << 8 | pos2promoted(posImport(to, player));
     }
     else if (input[3] > 'E') 
     {
         // placement of a off-board piece
-        sscanf(input, "%2X%s", &to, piece);
+        if (sscanf(input, "%2X%2s", &to, piece) != 2) return 0;
         return (Pos)hashPiece(piece) << 8 | posImport(to, player);
     }
     else
     {
         // movement without promotion
-        sscanf(input, "%2X%2X", &from, &to);
+        if (sscanf(input, "%2X%2X", &from, &to) != 2) return 0;
         from = posImport(from, player); to = posImport(to, player);
+        if ((place = getPos(board, from)) == -1) return 0;
         // revise pos if the moved piece is promoted
-        if (isPromoted(((Pos*)&board)[getPos(board, from)]))
+        if (isPromoted(((Pos*)&board)[place]))
         {
             from = pos2promoted(from);
             to = pos2promoted(to);
@@ -266,31 +318,48 @@ Move readMove(Board board, int player)
     }
 }
 
-// print out the formal instruction of a move
-void printMove(Move move)
+// read and parse the input instruction
+Move readMove(Board board, int player)
+{
+    char input[6];
+    scanf("%5s", input);
+    return parseMove(board, player, input);
+}
+
+// write the formal instruction of a move into str (at least 6 chars supposed)
+char* formatMove(Move move, char* str)
 {
     if ((move >> 8) < KING)
     {
         // placement of a off-board piece
         switch (move >> 8)
         {
-            case PAWN: printf("%02XFU\n", posExport(move & 0xFF)); break;
-            case ROOK: printf("%02XHI\n", posExport(move & 0xFF)); break;
-            case BISHOP: printf("%02XKK\n", posExport(move & 0xFF)); break;
-            case SILVER: printf("%02XGI\n", posExport(move & 0xFF)); break;
-            case GOLD: printf("%02XKI\n", posExport(move & 0xFF)); break;
+            case PAWN: sprintf(str, "%02XFU", posExport(move & 0xFF)); break;
+            case ROOK: sprintf(str, "%02XHI", posExport(move & 0xFF)); break;
+            case BISHOP: sprintf(str, "%02XKK", posExport(move & 0xFF)); break;
+            case SILVER: sprintf(str, "%02XGI", posExport(move & 0xFF)); break;
+            case GOLD: sprintf(str, "%02XKI", posExport(move & 0xFF)); break;
         }
     }
     else if (isPromoted(move >> 8) ^ isPromoted(move & 0xFF))
     {
         // movement with promotion
-        printf("%02X%02XN\n", posExport(move >> 8), posExport(move & 0xFF));
+        sprintf(str, "%02X%02XN", posExport(move >> 8), posExport(move & 0xFF));
     }
     else
     {
         // movement without promotion
-        printf("%02X%02X\n", posExport(move >> 8), posExport(move & 0xFF));
+        sprintf(str, "%02X%02X", posExport(move >> 8), posExport(move & 0xFF));
     }
+
+    return str;
+}
+
+// print out the formal instruction of a move
+void printMove(Move move)
+{
+    char str[6];
+    printf("%s\n", formatMove(move, str));
 }
 
 // return 1 when the given pos is in the board else 0
@@ -378,16 +447,21 @@ int isDecidableMove(Board board, History hist, Move move)
 // else 0
 int isRepetitiveMove(Board board, History hist, Move move)
 {
-    int counter = 1, check = 1;
-    Key hash;
     setBoard(&board, move);
-    hash = hashBoard(board, hist.turn % 2);
+    return getRepetition(&hist, hashBoard(board, hist.turn % 2));
+}
+
+// the same as isRepetitiveMove, with the hashed value of the board after the move given
+int getRepetition(History* hist, Key hash)
+{
+    int counter = 1, check = hash & 1;
 
     // there will not be a same hash value when player is different
-    for (int i = hist.turn; i > 0; i -= 2)
+    // so only the boards made by the same player (past[turn - 2], past[turn - 4], ...) are compared
+    for (int i = hist->turn - 2; i >= 0; i -= 2)
     {
-        counter += hash == hist.past[i - 1];
-        check &= (hash & 1);
+        counter += hash == hist->past[i];
+        check &= (hist->past[i] & 1);
         if (check && counter == 4) return 2;
     }
 
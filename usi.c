@@ -0,0 +1,227 @@
+#include <pthread.h>
+
+// line-based engine protocol (USI style) on stdin / stdout
+// moves are written in the same notation as printMove, for example: 1E2D 2D1CN 3CFU
+// supported commands:
+//     usi / isready / usinewgame / quit
+//     setoption name Engine value AlphaBeta|MCTS, setoption name Threads value n (threads of MCTS)
+//     setoption name MultiPV value n (number of best moves reported by alpha-beta)
+//     position startpos [moves m1 m2 ...]
+//     go [ponder] [btime t] [wtime t] [binc t] [winc t] [byoyomi t] [movetime t] [depth d] [nodes n] [infinite]
+//         (nodes counts playouts for MCTS, a ponder search ignores the time and nodes until ponderhit)
+//     stop / ponderhit
+//     d (print the current board, for debug)
+// search runs on another thread so that stop and ponderhit are handled while thinking
+
+#define MAX_LINE_LEN 4096
+
+// the position given by the last position command
+Board usiboard;
+History usihist;
+// the running search
+SearchInfo engine;
+pthread_t searcher;
+int searching = 0;
+// set only by stopSearch, the search sets engine.stop itself when it reaches its limits
+volatile int usistop = 0;
+Engine usiengine = ALPHABETA;
+int usimultipv = 1;
+
+void printBoard(Board board);
+long long allotTime(long long remain, long long inc, long long byoyomi);
+void* searchThread(void* arg);
+void stopSearch(void);
+void setOption(char* args);
+int playMove(Board* bp, History* hist, Key* hash, const char* input);
+void setPosition(char* args);
+void startSearch(char* args);
+int usiLoop(void);
+
+// time to spend on this move (ms)
+// remain: time left on the clock, inc: increment per move, byoyomi: time per move after the clock runs out
+long long allotTime(long long remain, long long inc, long long byoyomi)
+{
+    // keep a margin for the communication delay
+    long long margin = 50, limit = remain + byoyomi - margin, t;
+
+    t = remain / 20 + inc + byoyomi;
+    if (t > limit) t = limit;
+    return (t < 10) ? 10 : t;
+}
+
+// entry of the search thread
+void* searchThread(void* arg)
+{
+    SearchInfo* si = (SearchInfo*)arg;
+    Move best = (usiengine == MONTECARLO) ? mctsThink(si) : think(si);
+    char str[6], ponder[6];
+
+    // bestmove must not be sent before stop or ponderhit when pondering or searching infinitely
+    while ((si->pondering || si->infinite) && !usistop) nanosleep(&(struct timespec){0, 1000000}, NULL);
+
+    if (!best) printf("bestmove resign\n");
+    else if (si->ponder) printf("bestmove %s ponder %s\n", formatMove(best, str), formatMove(si->ponder, ponder));
+    else printf("bestmove %s\n", formatMove(best, str));
+    fflush(stdout);
+
+    return NULL;
+}
+
+// stop the running search and wait for its bestmove
+void stopSearch(void)
+{
+    if (!searching) return;
+    usistop = engine.stop = 1;
+    pthread_join(searcher, NULL);
+    searching = 0;
+}
+
+// setoption name <id> [value <x>]
+void setOption(char* args)
+{
+    char name[64] = "", value[64] = "";
+
+    sscanf(args, " name %63s value %63s", name, value);
+    if (!strcmp(name, "Engine")) usiengine = strcmp(value, "MCTS") ? ALPHABETA : MONTECARLO;
+    else if (!strcmp(name, "Threads")) mctsthreads = atoi(value);
+    else if (!strcmp(name, "MultiPV")) usimultipv = atoi(value);
+    // USI_Ponder is accepted as is, the engine ponders whenever it gets go ponder
+    else if (strcmp(name, "USI_Ponder")) printf("info string unknown option %s\n", name);
+}
+
+// apply a move given in the notation of printMove to the position and its history
+// hash: hashed value of the position, updated in place
+// return 0 without touching anything when the move is illegal else 1
+// the game ends in a draw at MAX_TURNS_NUM - 2 turns (as in the self-play and the search)
+// which also leaves room in hist for the search and the pawn drop mate test on the last position
+int playMove(Board* bp, History* hist, Key* hash, const char* input)
+{
+    Move move, moves[MAX_MOVES_LEN];
+    int count, i;
+
+    if (hist->turn >= MAX_TURNS_NUM - 2 || (strlen(input) != 4 && strlen(input) != 5)) return 0;
+    count = getMoveListCached(*bp, *hist, moves);
+    move = parseMove(*bp, hist->turn % 2, input);
+    for (i = 0; i < count && moves[i] != move; i++);
+    if (i == count) return 0;
+
+    *hash = updateHash(*bp, *hash, move);
+    hist->past[hist->turn++] = *hash;
+    setBoard(bp, move);
+    return 1;
+}
+
+// position startpos [moves m1 m2 ...]
+void setPosition(char* args)
+{
+    Key hash;
+    char* token = strtok(args, " \t\n");
+
+    initBoard(&usiboard);
+    initHistory(&usihist);
+    hash = hashBoard(usiboard, DEFENDER);
+    if (!token || strcmp(token, "startpos")) printf("info string only startpos is supported\n");
+
+    token = strtok(NULL, " \t\n");
+    if (!token || strcmp(token, "moves")) return;
+
+    while ((token = strtok(NULL, " \t\n")))
+    {
+        if (!playMove(&usiboard, &usihist, &hash, token))
+        {
+            printf("info string illegal move %s\n", token);
+            fflush(stdout);
+            return;
+        }
+    }
+}
+
+// go [ponder] [btime t] [wtime t] [binc t] [winc t] [byoyomi t] [movetime t] [depth d] [nodes n] [infinite]
+void startSearch(char* args)
+{
+    long long remain[2] = {0, 0}, inc[2] = {0, 0}, byoyomi = 0, movetime = 0;
+    int player = usihist.turn % 2, timed = 0;
+    char* token = strtok(args, " \t\n");
+
+    stopSearch();
+    engine.board = usiboard;
+    engine.hist = usihist;
+    engine.maxdepth = 0;
+    engine.multipv = usimultipv;
+    engine.maxnodes = 0;
+    engine.timelimit = 0;
+    usistop = engine.stop = engine.pondering = engine.infinite = 0;
+    engine.verbose = 1;
+
+    for (; token; token = strtok(NULL, " \t\n"))
+    {
+        if (!strcmp(token, "ponder")) engine.pondering = 1;
+        else if (!strcmp(token, "infinite")) engine.infinite = 1;
+        else
+        {
+            char* value = strtok(NULL, " \t\n");
+            if (!value) break;
+            // black (先手) is the attacker
+            if (!strcmp(token, "btime")) { remain[ATTACKER] = atoll(value); timed = 1; }
+            else if (!strcmp(token, "wtime")) { remain[DEFENDER] = atoll(value); timed = 1; }
+            else if (!strcmp(token, "binc")) inc[ATTACKER] = atoll(value);
+            else if (!strcmp(token, "winc")) inc[DEFENDER] = atoll(value);
+            else if (!strcmp(token, "byoyomi")) { byoyomi = atoll(value); timed = 1; }
+            else if (!strcmp(token, "movetime")) movetime = atoll(value);
+            else if (!strcmp(token, "depth")) engine.maxdepth = atoi(value);
+            else if (!strcmp(token, "nodes")) engine.maxnodes = atoll(value);
+        }
+    }
+
+    if (movetime) engine.timelimit = movetime;
+    else if (timed) engine.timelimit = allotTime(remain[player], inc[player], byoyomi);
+
+    engine.start = getTime();
+    searching = !pthread_create(&searcher, NULL, searchThread, &engine);
+}
+
+// read commands until quit (or end of input)
+int usiLoop(void)
+{
+    char line[MAX_LINE_LEN], command[32];
+    int len;
+
+    initHashTable(&table);
+    initBoard(&usiboard);
+    initHistory(&usihist);
+
+    while (fgets(line, MAX_LINE_LEN, stdin))
+    {
+        if (sscanf(line, "%31s%n", command, &len) != 1) continue;
+
+        if (!strcmp(command, "usi"))
+        {
+            printf("id name 2020GroupWorkB\n");
+            printf("id author 2020GroupWorkB\n");
+            printf("option name USI_Ponder type check default true\n");
+            printf("option name Engine type combo default AlphaBeta var AlphaBeta var MCTS\n");
+            printf("option name Threads type spin default 1 min 1 max %d\n", MAX_THREADS);
+            printf("option name MultiPV type spin default 1 min 1 max %d\n", MAX_MULTIPV);
+            printf("usiok\n");
+        }
+        else if (!strcmp(command, "isready")) printf("readyok\n");
+        else if (!strcmp(command, "setoption")) setOption(line + len);
+        else if (!strcmp(command, "usinewgame")) { stopSearch(); clearTable(); clearTree(); clearMoveCache(); }
+        else if (!strcmp(command, "position")) { stopSearch(); setPosition(line + len); }
+        else if (!strcmp(command, "go")) startSearch(line + len);
+        else if (!strcmp(command, "stop")) stopSearch();
+        else if (!strcmp(command, "ponderhit"))
+        {
+            // the predicted move was played, go on searching under the normal time limit
+            engine.start = getTime();
+            engine.pondering = 0;
+        }
+        else if (!strcmp(command, "d")) printBoard(usiboard);
+        else if (!strcmp(command, "quit")) break;
+        else printf("info string unknown command %s\n", command);
+        fflush(stdout);
+    }
+
+    stopSearch();
+    return 0;
+}